@@ -1,544 +1,265 @@
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
 #include <cassert>
 #include <stdarg.h>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
 #include "pin.H"
+#include "brchTrace.h"
+#include "brchPredict.h"
 
 using namespace std;
 
-typedef unsigned char       UINT8;
-typedef unsigned short      UINT16;
-typedef unsigned int        UINT32;
-typedef unsigned long int   UINT64;
-typedef unsigned __int128   UINT128;
-
- 
-
 ofstream OutFile;
 
-// 将val截断, 使其宽度变成bits
-#define truncate(val, bits) ((val) & ((1 << (bits)) - 1))
-
 static UINT64 takenCorrect = 0;
 static UINT64 takenIncorrect = 0;
 static UINT64 notTakenCorrect = 0;
 static UINT64 notTakenIncorrect = 0;
 
-// 饱和计数器 (N < 64)
-class SaturatingCnt
-{
-    size_t m_wid;
-    UINT8 m_val;
-    const UINT8 m_init_val;
-
-    public:
-        SaturatingCnt(size_t width = 2) : m_init_val((1 << width) / 2)
-        {
-            m_wid = width;
-            m_val = m_init_val;
-        }
-
-        void increase() { if (m_val < (1 << m_wid) - 1) m_val++; }
-        void decrease() { if (m_val > 0) m_val--; }
-
-        void reset() { m_val = m_init_val; }
-        UINT8 getVal() { return m_val; }
-        size_t getWidth(){return m_wid; }
-
-        bool isTaken() { return (m_val > (1 << m_wid)/2 - 1); }
-};
+BranchPredictor* BP;
+BranchProfile profile;          // BP (预测器集合模式下为第一个预测器) 在每条静态分支上的表现
 
-// 移位寄存器 (N < 128)
-class ShiftReg
+// This function is called for every conditional branch drained from the branch buffer
+void predictBranch(ADDRINT pc, BOOL direction)
 {
-    size_t m_wid;
-    UINT128 m_val;
-
-    public:
-        ShiftReg(size_t width) : m_wid(width), m_val(0) {}
-
-        bool shiftIn(bool b)
-        {
-            bool ret = !!(m_val & (1 << (m_wid - 1)));
-            m_val <<= 1;
-            m_val |= b;
-            m_val &= (1 << m_wid) - 1;
-            return ret;
-        }
-
-        UINT128 getVal() { return m_val; }
-
-        size_t getMid() {return m_wid;}
-};
-
-// Hash functions
-inline  UINT128 f_xor(UINT128 a, UINT128 b) { return a ^ b; }
-inline UINT128 f_xor1(UINT128 a, UINT128 b) { return ~a ^ ~b; }
-inline UINT128 f_xnor(UINT128 a, UINT128 b) { return ~(a ^ ~b); }
-
+    BOOL prediction = BP->predict(pc);
+    BP->update(direction, prediction, pc);
+    profile.record(pc, direction, prediction != direction);
+    if (prediction)
+    {
+        if (direction)
+            takenCorrect++;
+        else
+            takenIncorrect++;
+    }
+    else
+    {
+        if (direction)
+            notTakenIncorrect++;
+        else
+            notTakenCorrect++;
+    }
+}
 
+/* ===================================================================== */
+/* Branch buffer: one inlined fill per conditional branch                */
+/* ===================================================================== */
+// 每条条件分支只插入一个INS_InsertFillBuffer, Pin把PC和方向内联写入每个线程自己的缓冲区,
+// 缓冲区满或线程退出时回调一次, 整批分支送入预测器. 预测器是全局的, 回调之间用锁串行.
+#define BRANCH_BATCH        4096
 
-// Base class of all predictors
-class BranchPredictor
+struct BranchRecord
 {
-    public:
-        BranchPredictor() {}
-        virtual ~BranchPredictor() {}
-        virtual bool predict(ADDRINT addr) { return false; };
-        virtual void update(bool takenActually, bool takenPredicted, ADDRINT addr) {};
+    ADDRINT pc;
+    ADDRINT target;
+    BOOL taken;
+    UINT32 info;                // BranchType | (指令长度 << 8)
 };
 
-BranchPredictor* BP;
-
+#define BRANCH_BUF_PAGES    (BRANCH_BATCH * sizeof(BranchRecord) / 4096)
 
+BUFFER_ID branchBufId;
+PIN_LOCK branchLock;
 
 /* ===================================================================== */
-/* BHT-based branch predictor                                            */
+/* Predictor set: evaluate several predictors on the same branch stream  */
 /* ===================================================================== */
-class BHTPredictor: public BranchPredictor
+// 每个预测器依次处理整批分支, 预测器的表在一批内保持在cache中.
+struct PredictorStats
 {
-    size_t m_entries_log;
-    SaturatingCnt* m_scnt;              // BHT
-    allocator<SaturatingCnt> m_alloc;
-    
-    public:
-        // Constructor
-        // param:   entry_num_log:  BHT行数的对数
-        //          scnt_width:     饱和计数器的位数, 默认值为2
-        BHTPredictor(size_t entry_num_log, size_t scnt_width = 2)
-        {
-            m_entries_log = entry_num_log;
-
-            m_scnt = m_alloc.allocate(1 << entry_num_log);      // Allocate memory for BHT
-            for (int i = 0; i < (1 << entry_num_log); i++)
-                m_alloc.construct(m_scnt + i, scnt_width);      // Call constructor of SaturatingCnt
-        }
-
-        // Destructor
-        ~BHTPredictor()
-        {
-            for (int i = 0; i < (1 << m_entries_log); i++)
-                m_alloc.destroy(m_scnt + i);
-
-            m_alloc.deallocate(m_scnt, 1 << m_entries_log);
-        }
-
-        BOOL predict(ADDRINT addr)
-        {
-            // TODO: Produce prediction according to BHT
-            return m_scnt[truncate(addr, m_entries_log)].isTaken();
-        }
-
-        void update(BOOL takenActually, BOOL takenPredicted, ADDRINT addr)
-        {
-            // TODO: Update BHT according to branch results and prediction
-            //预测跳转
-            if(takenPredicted){
-                //真跳
-                if(takenActually){
-                    m_scnt[truncate(addr, m_entries_log)].increase();
-                }
-                else{
-                    if(m_scnt[truncate(addr, m_entries_log)].getVal() == 2){
-                        m_scnt[truncate(addr, m_entries_log)].decrease();
-                        m_scnt[truncate(addr, m_entries_log)].decrease();
-                        
-                    }
-                    else{
-                        m_scnt[truncate(addr, m_entries_log)].decrease(); 
-                    }
-                }
-            }
-            else{
-                if(takenActually){
-                    if(m_scnt[truncate(addr, m_entries_log)].getVal() == 1){
-                        m_scnt[truncate(addr, m_entries_log)].increase();
-                        m_scnt[truncate(addr, m_entries_log)].increase();
-
-                    }
-                    else{
-                        m_scnt[truncate(addr, m_entries_log)].increase();                        
-                    }
-                }
-                else{
-                    m_scnt[truncate(addr, m_entries_log)].decrease();
-                }
-            }
-        }
+    string spec;
+    BranchPredictor* bp;
+    UINT64 takenCorrect;
+    UINT64 takenIncorrect;
+    UINT64 notTakenCorrect;
+    UINT64 notTakenIncorrect;
 };
 
-/* ===================================================================== */
-/* Global-history-based branch predictor                                 */
-/* ===================================================================== */
-template<UINT128 (*hash)(UINT128 addr, UINT128 history)>
-class GlobalHistoryPredictor: public BranchPredictor
-{
-    ShiftReg* m_ghr;                   // GHR
-    SaturatingCnt* m_scnt;              // PHT中的分支历史字段
-    size_t m_entries_log;                   // PHT行数的对数
-    allocator<SaturatingCnt> m_alloc;
-    
-    public:
-        // Constructor
-        // param:   ghr_width:      Width of GHR
-        //          entry_num_log:  PHT表行数的对数
-        //          scnt_width:     饱和计数器的位数, 默认值为2
-        GlobalHistoryPredictor(size_t ghr_width, size_t entry_num_log, size_t scnt_width = 2)
-        {
-            // TODO:
-            m_entries_log = entry_num_log;
-
-            m_scnt = m_alloc.allocate(1 << entry_num_log);
-            for(int i = 0; i < (1 << entry_num_log); i++){
-                m_alloc.construct(m_scnt + i, scnt_width);
-            }
-            m_ghr = new ShiftReg(ghr_width);
+vector<PredictorStats> predictorSet;
+UINT64 insCount = 0;
+BranchTargetUnit* targetUnit = NULL;    // -targets时模拟BTB, ITTAGE和RAS
 
-        }
+// -trace时记录所有控制流指令, 供brchReplay离线重放.
+// 记录同样来自各线程的分支缓冲区, 在branchLock下写入 (BranchTraceWriter不是线程安全的),
+// 因此多线程程序的trace按批交织, 每批内是一个线程连续执行的分支.
+BranchTraceWriter traceWriter;
+bool traceOn = false;
 
-        // Destructor
-        ~GlobalHistoryPredictor()
-        {
-            // TODO
-            for(int i = 0; i< (1 << m_entries_log); i++){
-                m_alloc.destroy(m_scnt + i);
-            }
-            m_alloc.deallocate(m_scnt, 1 << m_entries_log);
-        }
-
-        // Only for TAGE: return a tag according to the specificed address
-        UINT128 get_tag(ADDRINT addr)
-        {
-            // TODO
-           return truncate((*hash)(addr, get_ghr()), m_ghr->getMid());
-        }
-
-        // Only for TAGE: return GHR's value
-        UINT128 get_ghr()
-        {
-            // TODO
-            return m_ghr->getVal();
-        }
-
-        UINT128 getMid(){
-            return m_ghr->getMid();
-        }
-
-        // Only for TAGE: reset a saturating counter to default value (which is weak taken)
-        void reset_ctr(ADDRINT addr)
-        {
-            // TODO
-            m_scnt[get_tag(addr)].reset();
-        }
-
-        bool predict(ADDRINT addr)
-        {
-            // TODO: Produce prediction according to GHR and PHT
-            return m_scnt[get_tag(addr)].isTaken();
-        }
-
-        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
-        {
-            // TODO: Update GHR and PHT according to branch results and prediction
-             //预测跳转
-
-             UINT128 getaddr = get_tag(addr);
-            if(takenPredicted){
-                //真跳
-                if(takenActually){
-                    m_scnt[getaddr].increase();
-                }
-                else{
-                    if(m_scnt[getaddr].getVal() == 2){
-                        m_scnt[getaddr].decrease();
-                        m_scnt[getaddr].decrease();
-                        
-                    }
-                    else{
-                        m_scnt[getaddr].decrease(); 
-                    }
-                }
-            }
-            else{
-                if(takenActually){
-                    if(m_scnt[getaddr].getVal() == 1){
-                        m_scnt[getaddr].increase();
-                        m_scnt[getaddr].increase();
-
-                    }
-                    else{
-                        m_scnt[getaddr].increase();                        
-                    }
-                }
-                else{
-                    m_scnt[getaddr].decrease();
-                }
-            }
-            //更新ghr
-            if(takenActually){
-                m_ghr->shiftIn(1);
-            }
-            else{
-                m_ghr->shiftIn(0);
-            }
-            // m_ghr->shiftIn(takenActually);
-        }
-};
-
-/* ===================================================================== */
-/* Tournament predictor: Select output by global/local selection history */
-/* ===================================================================== */
-class TournamentPredictor: public BranchPredictor
+void recordBatch(const BranchRecord* recs, size_t num)
 {
-    BranchPredictor* m_BPs[2];      // Sub-predictors
-    SaturatingCnt* m_gshr;          // Global select-history register
-
-    public:
-        TournamentPredictor(BranchPredictor* BP0, BranchPredictor* BP1, size_t gshr_width = 2)
-        {
-            // TODO
-            m_BPs[0] = BP0;
-            m_BPs[1] = BP1;
-            m_gshr = new SaturatingCnt(gshr_width);
-        }
-
-        ~TournamentPredictor()
-        {
-            // TODO
-            delete m_BPs[0];
-            delete m_BPs[1];
-        }
+    for (size_t i = 0; i < num; i++)
+    {
+        BranchTraceRec rec;
+        rec.pc = recs[i].pc;
+        rec.target = recs[i].taken ? recs[i].target : 0;
+        rec.type = recs[i].info & 0xff;
+        rec.size = recs[i].info >> 8;
+        rec.taken = recs[i].taken;
+        traceWriter.append(rec);
+    }
+}
 
-        // TODO
+// Run BP, or every predictor of the set, over a batch of branches
+void processBatch(const BranchRecord* recs, size_t num)
+{
+    if (traceOn)
+        recordBatch(recs, num);
 
-        bool predict(ADDRINT addr){
-            if(truncate(m_gshr->getVal()>> (m_gshr->getWidth() - 1), 1)){
-                return m_BPs[0]->predict(addr);
-            }
-            else{
-                return m_BPs[1]->predict(addr);
-            }
+    if (targetUnit)
+    {
+        for (size_t i = 0; i < num; i++)
+            targetUnit->process(recs[i].pc, recs[i].target, recs[i].taken, recs[i].info & 0xff, recs[i].info >> 8);
+    }
 
-        }
+    if (predictorSet.empty())
+    {
+        for (size_t i = 0; i < num; i++)
+            if ((recs[i].info & 0xff) == BR_COND) predictBranch(recs[i].pc, recs[i].taken);
+        return;
+    }
 
-        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
+    for (size_t p = 0; p < predictorSet.size(); p++)
+    {
+        PredictorStats& st = predictorSet[p];
+        for (size_t i = 0; i < num; i++)
         {
-            m_BPs[0]->update(takenActually, takenPredicted, addr);
-            m_BPs[1]->update(takenActually, takenPredicted, addr);
-            
-            if(m_BPs[0]->predict(addr) != m_BPs[1]->predict(addr)){
-                if(m_BPs[0]->predict(addr) == takenActually){
-                    m_gshr->decrease();
-                }
-                else{
-                    m_gshr->increase();
-                }
+            if ((recs[i].info & 0xff) != BR_COND) continue;
+            bool taken = recs[i].taken;
+            bool prediction = st.bp->predict(recs[i].pc);
+            st.bp->update(taken, prediction, recs[i].pc);
+            if (p == 0) profile.record(recs[i].pc, taken, prediction != taken);
+            if (prediction)
+            {
+                if (taken) st.takenCorrect++;
+                else st.takenIncorrect++;
             }
-        }
-};
-
-/* ===================================================================== */
-/* TArget GEometric history length Predictor                             */
-/* ===================================================================== */
-template<UINT128 (*hash1)(UINT128 pc, UINT128 ghr), UINT128 (*hash2)(UINT128 pc, UINT128 ghr)>
-class TAGEPredictor: public BranchPredictor
-{
-    const size_t m_tnum;            // 子预测器个数 (T[0 : m_tnum - 1])
-    const size_t m_entries_log;     // 子预测器T[1 : m_tnum - 1]的PHT行数的对数
-    BranchPredictor** m_T;          // 子预测器指针数组
-    bool* m_T_pred;                 // 用于存储各子预测的预测值
-    UINT8** m_useful;               // usefulness matrix
-    size_t provider_indx;              // Provider's index of m_T
-    size_t altpred_indx;               // Alternate provider's index of m_T
-    
-    const size_t m_rst_period;      // Reset period of usefulness
-    size_t m_rst_cnt;               // Reset counter
-
-    int tnum = 0;
-
-    public:
-        // Constructor
-        // param:   tnum:               The number of sub-predictors
-        //          T0_entry_num_log:   子预测器T0的BHT行数的对数
-        //          T1ghr_len:          子预测器T1的GHR位宽
-        //          alpha:              各子预测器T[1 : m_tnum - 1]的GHR几何倍数关系
-        //          Tn_entry_num_log:   各子预测器T[1 : m_tnum - 1]的PHT行数的对数
-        //          scnt_width:         Width of saturating counter (3 by default)
-        //          rst_period:         Reset period of usefulness
-        TAGEPredictor(size_t tnum, size_t T0_entry_num_log, size_t T1ghr_len, float alpha, size_t Tn_entry_num_log, size_t scnt_width = 3, size_t rst_period = 256*1024)
-        : m_tnum(tnum), m_entries_log(Tn_entry_num_log), m_rst_period(rst_period), m_rst_cnt(0)
-        {
-
-            m_T = new BranchPredictor* [m_tnum];
-            m_T_pred = new bool [m_tnum];
-            m_useful = new UINT8* [m_tnum];
-
-            m_T[0] = new BHTPredictor(T0_entry_num_log);
-
-            size_t ghr_size = T1ghr_len;
-            for (size_t i = 1; i < m_tnum; i++)
+            else
             {
-                m_T[i] = new GlobalHistoryPredictor<hash1>(ghr_size, m_entries_log, scnt_width);
-                ghr_size = (size_t)(ghr_size * alpha);
-
-                m_useful[i] = new UINT8 [1 << m_entries_log];
-                memset(m_useful[i], 0, sizeof(UINT8)*(1 << m_entries_log));
+                if (taken) st.notTakenIncorrect++;
+                else st.notTakenCorrect++;
             }
         }
+    }
+}
 
-        ~TAGEPredictor()
-        {
-            for (size_t i = 0; i < m_tnum; i++) delete m_T[i];
-            for (size_t i = 0; i < m_tnum; i++) delete[] m_useful[i];
+// Pin calls this when a thread's branch buffer is full or the thread exits
+VOID* BranchBufferFull(BUFFER_ID id, THREADID tid, const CONTEXT* ctxt, VOID* buf, UINT64 num, VOID* v)
+{
+    PIN_GetLock(&branchLock, tid + 1);
+    processBatch((const BranchRecord*)buf, num);
+    PIN_ReleaseLock(&branchLock);
+    return buf;
+}
 
-            delete[] m_T;
-            delete[] m_T_pred;
-            delete[] m_useful;
-        }
+UINT32 branchType(INS ins)
+{
+    if (INS_Category(ins) == XED_CATEGORY_COND_BR) return BR_COND;
+    if (INS_IsRet(ins)) return BR_RET;
+    if (INS_IsCall(ins)) return INS_IsIndirectControlFlow(ins) ? BR_CALL_IND : BR_CALL;
+    return INS_IsIndirectControlFlow(ins) ? BR_JUMP_IND : BR_JUMP;
+}
 
-        bool predict(ADDRINT addr)
-        {
-            // TODO
-            altpred_indx = 0;
-            provider_indx = 0;
-           // ADDRINT hash1addr = -2;
-            ADDRINT hash2addr = -1;
-            ADDRINT tag = 0;
-            m_T_pred[0] = m_T[0]->predict(addr);
-
-            for(size_t i = 1; i < m_tnum; i++){
-                 //hash1addr = truncate((*hash1)(addr, ((GlobalHistoryPredictor<hash1>*)m_T[i])->get_ghr()), ((GlobalHistoryPredictor<hash1>*)m_T[i])->getMid());
-                 hash2addr = truncate((*hash2)(addr, ((GlobalHistoryPredictor<hash1>*)m_T[i])->get_ghr()), ((GlobalHistoryPredictor<hash1>*)m_T[i])->getMid());
-                m_T_pred[i] = m_T[i]->predict(addr);
-                 tag = truncate(((GlobalHistoryPredictor<hash1>*)m_T[i])->get_tag(addr), ((GlobalHistoryPredictor<hash1>*)m_T[i])->getMid());
-                if(tag == hash2addr){
-                    altpred_indx = provider_indx;
-                    provider_indx = i;
-                   // printf("\n%ld \n  ", provider_indx)     ;   
-                }
-            
-                
-            }
-            //printf("%ld, + %ld + %ld + %ld + %ld \n ", tag, hash2addr, hash1addr, provider_indx, addr);
-            return m_T_pred[provider_indx];
-        }
+// Type and length of a control-flow instruction, packed as in BranchRecord::info
+UINT32 branchInfo(INS ins)
+{
+    return branchType(ins) | (INS_Size(ins) << 8);
+}
 
-        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
-        {
-            // TODO: Update provider itself
-                  ADDRINT hash1addr = truncate(addr, 17);
-                if(provider_indx != 0){
-                    hash1addr = truncate( ((GlobalHistoryPredictor<hash2>*)m_T[provider_indx])->get_tag(addr), ((GlobalHistoryPredictor<hash1>*)m_T[provider_indx])->getMid());
-                    m_T[provider_indx]->update(takenActually, takenPredicted, addr); 
-                }
-                else{
-                    m_T[provider_indx]->update(takenActually, takenPredicted, addr);
-                }
-                // m_T[provider_indx]->update(takenActually, takenPredicted, addr);
-                
-            // TODO: Update usefulness
-                if(m_T_pred[provider_indx] != m_T_pred[altpred_indx]){
-                
-                    m_useful[provider_indx][hash1addr] = (m_T_pred[provider_indx] == takenActually ) ? m_useful[provider_indx][hash1addr] + 1 : m_useful[provider_indx][hash1addr] -1;
-                    
-                }
-
-
-            // TODO: Reset usefulness periodically
-                 m_rst_cnt++;
-                if(m_rst_cnt >= m_rst_period){
-                    for(size_t i = 1; i < m_tnum; i++){
-                        for(size_t j = 0; j < (size_t)sizeof(m_useful[i]); j++){
-                            m_useful[i][j] = (m_useful[i][j] << 1) >> 1;
-                            m_useful[i][j] = (m_useful[i][j] >> 1) << 1;
-                            
-                        }
-                    }
-                    // for (size_t i = 1; i < m_tnum ; i++) {
-                    //      memset(m_useful[i], 0, sizeof(UINT8) * (1 << m_entries_log));
-                    // }
-                    m_rst_cnt = 0;
-                }
-             
-            // TODO: Entry replacement
-            
-            size_t now = m_tnum -1 ;
-            now++;
-            size_t index_update = now + 1 ;
-            
-            if(takenActually != takenPredicted){
-                //printf("%ld, %d, %d  %d  %ld %ld, %ld, %ld", hash1addr, 1 << m_entries_log, (int)hash1addr, (int)m_tnum, now, index_update, provider_indx, provider_indx);
-                for(size_t i = now -1  ;i > provider_indx; i--){
-                   //  printf("\n%d  \n", m_useful[i][hash1addr]);
-                    if(m_useful[i][hash1addr] == 0){
-                        index_update = i;
-                    }
-                }
-               // printf("\n %ld  %ld\n", index_update, m_tnum + 1);
-                now = m_tnum - 1;
-                now++;
-                if(index_update != m_tnum +1){
-                    //printf("\n %ld  \n", index_update);
-                    ((GlobalHistoryPredictor<hash1>*)m_T[index_update])->reset_ctr(addr);
-                    m_useful[index_update][hash1addr] = 0;
-                }
-                else{
-                    for(size_t i = now - 1 ;i > provider_indx; i--){
-                        m_useful[i][hash1addr] = m_useful[i][hash1addr] - 1 ;
-                    }
-                    
-                }
-            }
-            
-        }
-};
+// Count instructions per basic block for MPKI
+void countIns(UINT32 num)
+{
+    insCount += num;
+}
 
+// Pin calls this function every time a new instruction is encountered
+void Instruction(INS ins, void * v)
+{
+    // Record conditional branches into the branch buffer, and with -targets or -trace every other
+    // control-flow instruction as well
+    if (INS_Category(ins) == XED_CATEGORY_COND_BR || ((targetUnit || traceOn) && INS_IsControlFlow(ins)))
+        INS_InsertFillBuffer(ins, IPOINT_BEFORE, branchBufId,
+                             IARG_INST_PTR, offsetof(BranchRecord, pc),
+                             IARG_BRANCH_TARGET_ADDR, offsetof(BranchRecord, target),
+                             IARG_BRANCH_TAKEN, offsetof(BranchRecord, taken),
+                             IARG_UINT32, branchInfo(ins), offsetof(BranchRecord, info), IARG_END);
+}
 
+// Pin calls this function every time a new trace is encountered
+void Trace(TRACE trace, void * v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+        BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)countIns, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+}
 
-// This function is called every time a control-flow instruction is encountered
-void predictBranch(ADDRINT pc, BOOL direction)
+// Print the side-by-side table of the predictor set
+void printPredictorSet(ostream& os)
 {
-    BOOL prediction = BP->predict(pc);
-    BP->update(direction, prediction, pc);
-    if (prediction)
+    os << endl << setw(40) << left << "predictor" << setw(14) << "branches" << setw(14) << "mispredicts"
+       << setw(12) << "accuracy" << "MPKI" << endl;
+    for (size_t p = 0; p < predictorSet.size(); p++)
     {
-        if (direction)
-            takenCorrect++;
-        else
-            takenIncorrect++;
-    }
-    else
-    {
-        if (direction)
-            notTakenIncorrect++;
-        else
-            notTakenCorrect++;
+        PredictorStats& st = predictorSet[p];
+        UINT64 wrong = st.takenIncorrect + st.notTakenIncorrect;
+        UINT64 total = wrong + st.takenCorrect + st.notTakenCorrect;
+        os << setw(40) << left << st.spec << setw(14) << total << setw(14) << wrong
+           << setw(12) << fixed << setprecision(2) << (total ? 100.0 * (total - wrong) / total : 0)
+           << (insCount ? 1000.0 * wrong / insCount : 0) << endl;
     }
+    os << "instructions: " << insCount << endl;
 }
 
-// Pin calls this function every time a new instruction is encountered
-void Instruction(INS ins, void * v)
+// Print the branches with the most mispredictions, with routine and source line
+void printProfile(ostream& os, const vector<BranchProfile::Entry>& top, const vector<string>& where)
 {
-    if (INS_IsControlFlow(ins) && INS_HasFallThrough(ins))
+    os << endl << "top " << top.size() << " of " << profile.size() << " static branches by mispredictions:" << endl
+       << setw(20) << left << "pc" << setw(14) << "executions" << setw(14) << "mispredicts"
+       << setw(10) << "miss%" << setw(10) << "taken%" << "location" << endl;
+    for (size_t i = 0; i < top.size(); i++)
     {
-        // Insert a call to the branch target
-        INS_InsertCall(ins, IPOINT_TAKEN_BRANCH, (AFUNPTR)predictBranch,
-                        IARG_INST_PTR, IARG_BOOL, TRUE, IARG_END);
-
-        // Insert a call to the next instruction of a branch
-        INS_InsertCall(ins, IPOINT_AFTER, (AFUNPTR)predictBranch,
-                        IARG_INST_PTR, IARG_BOOL, FALSE, IARG_END);
+        const BranchProfile::Entry& e = top[i];
+        os << setw(20) << left << hexstr(e.pc) << setw(14) << dec << e.exec << setw(14) << e.mispred
+           << setw(10) << fixed << setprecision(2) << 100.0 * e.mispred / e.exec
+           << setw(10) << 100.0 * e.taken / e.exec << where[i] << endl;
     }
 }
 
 // This knob sets the output file name
 KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "brchPredict.txt", "specify the output file name");
 
+// This knob selects the predictor-set mode
+KNOB<string> KnobPredictors(KNOB_MODE_WRITEONCE, "pintool", "predictors", "",
+                            "comma-separated predictor specs evaluated in one run, e.g. bht:11,gshare:14:14,tage:8:13:5:2:10 (empty: BP only)");
+
+// This knob records the branch trace
+KNOB<string> KnobTrace(KNOB_MODE_WRITEONCE, "pintool", "trace", "",
+                       "record every control-flow instruction to this file for brchReplay (empty: no trace)");
+
+// This knob sets the length of the per-branch report
+KNOB<UINT32> KnobTop(KNOB_MODE_WRITEONCE, "pintool", "top", "20",
+                     "report the N static branches with the most mispredictions (0: no report)");
+
+// This knob enables the branch target models
+KNOB<string> KnobTargets(KNOB_MODE_WRITEONCE, "pintool", "targets", "",
+                         "simulate a BTB, ITTAGE and a RAS: btb_set_num_log,btb_assoc,ras_depth, e.g. 9,4,16 (empty: off)");
+
 // This function is called when the application exits
 VOID Fini(int, VOID * v)
 {
+    // 各线程缓冲区中剩余的分支已在线程退出时处理.
+    // 预测器集合模式下, 上面的四个计数取第一个预测器的结果
+    if (!predictorSet.empty())
+    {
+        takenCorrect = predictorSet[0].takenCorrect;
+        takenIncorrect = predictorSet[0].takenIncorrect;
+        notTakenCorrect = predictorSet[0].notTakenCorrect;
+        notTakenIncorrect = predictorSet[0].notTakenIncorrect;
+    }
+
 	double precision = 100 * double(takenCorrect + notTakenCorrect) / (takenCorrect + notTakenCorrect + takenIncorrect + notTakenIncorrect);
     
     cout << "takenCorrect: " << takenCorrect << endl
@@ -554,6 +275,48 @@ VOID Fini(int, VOID * v)
     	<< "nnotTakenIncorrect: " << notTakenIncorrect << endl
     	<< "Precision: " << precision << endl;
     
+    if (!predictorSet.empty())
+    {
+        printPredictorSet(cout);
+        printPredictorSet(OutFile);
+        for (size_t p = 0; p < predictorSet.size(); p++)
+            delete predictorSet[p].bp;
+    }
+
+    if (KnobTop.Value())
+    {
+        vector<BranchProfile::Entry> top;
+        vector<string> where;
+        profile.topK(KnobTop.Value(), top);
+
+        PIN_LockClient();
+        for (size_t i = 0; i < top.size(); i++)
+        {
+            INT32 line = 0;
+            string file;
+            PIN_GetSourceLocation(top[i].pc, NULL, &line, &file);
+            string rtn = RTN_FindNameByAddress(top[i].pc);
+            where.push_back((rtn.empty() ? "?" : rtn) + (file.empty() ? "" : " " + file + ":" + decstr(line)));
+        }
+        PIN_UnlockClient();
+
+        printProfile(cout, top, where);
+        printProfile(OutFile, top, where);
+    }
+
+    if (targetUnit)
+    {
+        targetUnit->dump(cout, insCount);
+        targetUnit->dump(OutFile, insCount);
+        delete targetUnit;
+    }
+
+    if (traceOn)
+    {
+        traceWriter.close(insCount);
+        cout << "branch trace: " << KnobTrace.Value() << ", " << traceWriter.getRecNum() << " records" << endl;
+    }
+
     OutFile.close();
     delete BP;
 }
@@ -582,12 +345,57 @@ int main(int argc, char * argv[])
 	// BP = new GlobalHistoryPredictor<f_xor>(14,14);
    //BP = new TournamentPredictor(new BHTPredictor(15),  new GlobalHistoryPredictor<f_xor>(15,15));
     //BP = new TAGEPredictor<f_xor, f_xor1>(2, 15, 16, 1 ,15);
+    //BP = new HashedPerceptronPredictor(4, 10, 8, 2);
+    //BP = new TAGESCLPredictor(8, 13, 5, 2, 10);
     
-    // Initialize pin
+    // Initialize pin, with symbols for the per-branch report
+    PIN_InitSymbols();
     if (PIN_Init(argc, argv)) return Usage();
     
     OutFile.open(KnobOutputFile.Value().c_str());
 
+    const string& specs = KnobPredictors.Value();
+    for (size_t start = 0; start < specs.size(); )
+    {
+        size_t end = specs.find(',', start);
+        if (end == string::npos) end = specs.size();
+        string spec = specs.substr(start, end - start);
+        start = end + 1;
+        if (spec.empty()) continue;
+
+        PredictorStats st = { spec, makePredictor(spec), 0, 0, 0, 0 };
+        if (st.bp) predictorSet.push_back(st);
+        else cerr << "unknown or invalid predictor spec: " << spec << endl;
+    }
+
+    PIN_InitLock(&branchLock);
+    branchBufId = PIN_DefineTraceBuffer(sizeof(BranchRecord), BRANCH_BUF_PAGES, BranchBufferFull, 0);
+    if (branchBufId == BUFFER_ID_INVALID)
+    {
+        cerr << "cannot allocate the branch buffer" << endl;
+        return 1;
+    }
+
+    if (!KnobTrace.Value().empty())
+    {
+        traceOn = traceWriter.open(KnobTrace.Value().c_str());
+        if (!traceOn) cerr << "cannot open branch trace " << KnobTrace.Value() << endl;
+    }
+
+    if (!KnobTargets.Value().empty())
+    {
+        UINT32 btb_sets_log, btb_assoc, ras_depth;
+        if (!parseTargetSpec(KnobTargets.Value().c_str(), btb_sets_log, btb_assoc, ras_depth))
+        {
+            cerr << "invalid -targets " << KnobTargets.Value()
+                 << ", expected btb_set_num_log(0-24),btb_assoc(1-64),ras_depth(1-65536)" << endl;
+            return 1;
+        }
+        targetUnit = new BranchTargetUnit(btb_sets_log, btb_assoc, ras_depth);
+    }
+    if (!predictorSet.empty() || traceOn || targetUnit)
+        TRACE_AddInstrumentFunction(Trace, 0);
+
     // Register Instruction to be called to instrument instructions
     INS_AddInstrumentFunction(Instruction, 0);
 
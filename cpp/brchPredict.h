@@ -0,0 +1,1704 @@
+#ifndef BRCH_PREDICT_H
+#define BRCH_PREDICT_H
+
+/*
+ * Branch predictors shared by the Pin tool (brchPredict.cpp) and the trace replay (brchReplay.cpp).
+ *
+ * 本文件不依赖pin.H, 预测器只通过predict/update与外界交互.
+ */
+
+#include "brchTrace.h"          // BranchType
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+typedef signed char         INT8;
+typedef unsigned char       UINT8;
+typedef unsigned short      UINT16;
+typedef int                 INT32;
+typedef unsigned int        UINT32;
+typedef unsigned long int   UINT64;
+typedef unsigned __int128   UINT128;
+typedef unsigned long int   ADDRINT;
+typedef bool                BOOL;
+
+// 将val截断, 使其宽度变成bits
+#define truncate(val, bits) ((val) & ((1 << (bits)) - 1))
+
+
+// 饱和计数器 (N < 64)
+class SaturatingCnt
+{
+    size_t m_wid;
+    UINT8 m_val;
+    const UINT8 m_init_val;
+
+    public:
+        SaturatingCnt(size_t width = 2) : m_init_val((1 << width) / 2)
+        {
+            m_wid = width;
+            m_val = m_init_val;
+        }
+
+        void increase() { if (m_val < (1 << m_wid) - 1) m_val++; }
+        void decrease() { if (m_val > 0) m_val--; }
+
+        void reset() { m_val = m_init_val; }
+        UINT8 getVal() { return m_val; }
+        size_t getWidth(){return m_wid; }
+
+        bool isTaken() { return (m_val > (1 << m_wid)/2 - 1); }
+};
+
+// 饱和计数器表: 计数器按2的幂的槽宽 (1, 2, 4, 8位) 紧密排列在UINT64字中, 不跨字.
+// 2位计数器每字32个, 2^20项只占256KB (SaturatingCnt数组为16MB).
+// 增减不分支: 用比较结果 (0或1) 左移到槽的位置后加到字上. 计数器宽度width为1到8,
+// 超出范围时截到边界 (更宽的计数器会溢出到相邻的槽).
+class SatCntTable
+{
+    UINT64* m_words;
+    size_t m_entries_log;
+    UINT32 m_slot_log;              // 槽宽的对数
+    UINT32 m_per_word_log;          // 每字计数器个数的对数
+    UINT64 m_slot_mask;
+    UINT64 m_max;                   // (1 << width) - 1
+    UINT64 m_init;                  // 初值, 弱跳转
+
+    UINT64& word(size_t i) { return m_words[i >> m_per_word_log]; }
+    UINT32 shift(size_t i) { return (i & ((1u << m_per_word_log) - 1)) << m_slot_log; }
+
+    public:
+        SatCntTable(size_t entry_num_log, size_t width = 2) : m_entries_log(entry_num_log)
+        {
+            width = width < 1 ? 1 : width > 8 ? 8 : width;
+            m_slot_log = width <= 1 ? 0 : width <= 2 ? 1 : width <= 4 ? 2 : 3;
+            m_per_word_log = 6 - m_slot_log;
+            m_slot_mask = (1ul << (1u << m_slot_log)) - 1;
+            m_max = (1ul << width) - 1;
+            m_init = (1ul << width) / 2;
+
+            size_t word_num = ((1ul << entry_num_log) + (1ul << m_per_word_log) - 1) >> m_per_word_log;
+            UINT64 fill = 0;
+            for (UINT32 k = 0; k < (1u << m_per_word_log); k++)
+                fill |= m_init << (k << m_slot_log);
+            m_words = new UINT64 [word_num];
+            for (size_t w = 0; w < word_num; w++)
+                m_words[w] = fill;
+        }
+
+        ~SatCntTable() { delete[] m_words; }
+
+        UINT8 getVal(size_t i) { return (word(i) >> shift(i)) & m_slot_mask; }
+        bool isTaken(size_t i) { return getVal(i) >= m_init; }
+
+        void increase(size_t i)
+        {
+            UINT32 sh = shift(i);
+            UINT64& w = word(i);
+            w += (UINT64)(((w >> sh) & m_slot_mask) < m_max) << sh;
+        }
+
+        void decrease(size_t i)
+        {
+            UINT32 sh = shift(i);
+            UINT64& w = word(i);
+            w -= (UINT64)(((w >> sh) & m_slot_mask) > 0) << sh;
+        }
+
+        void reset(size_t i)
+        {
+            UINT32 sh = shift(i);
+            UINT64& w = word(i);
+            w = (w & ~(m_slot_mask << sh)) | (m_init << sh);
+        }
+};
+
+// 移位寄存器 (N < 128)
+class ShiftReg
+{
+    size_t m_wid;
+    UINT128 m_val;
+
+    public:
+        ShiftReg(size_t width) : m_wid(width), m_val(0) {}
+
+        bool shiftIn(bool b)
+        {
+            bool ret = !!(m_val & ((UINT128)1 << (m_wid - 1)));
+            m_val <<= 1;
+            m_val |= b;
+            if (m_wid < 128) m_val &= ((UINT128)1 << m_wid) - 1;
+            return ret;
+        }
+
+        UINT128 getVal() { return m_val; }
+
+        size_t getMid() {return m_wid;}
+};
+
+// 循环全局历史缓冲区 (长度不限), 第0位是最新的一位
+class GlobalHistory
+{
+    UINT8* m_bits;
+    size_t m_mask;
+    size_t m_head;
+
+    GlobalHistory(const GlobalHistory&);
+    GlobalHistory& operator=(const GlobalHistory&);
+
+    public:
+        // 多保留一位, 使FoldedHistory能取到刚移出窗口的那一位
+        GlobalHistory(size_t length) : m_head(0)
+        {
+            size_t size = 1;
+            while (size < length + 1) size <<= 1;
+            m_mask = size - 1;
+            m_bits = new UINT8[size];
+            memset(m_bits, 0, size);
+        }
+
+        ~GlobalHistory() { delete[] m_bits; }
+
+        void push(bool b)
+        {
+            m_head = (m_head - 1) & m_mask;
+            m_bits[m_head] = b;
+        }
+
+        // The i-th most recent bit
+        bool operator[](size_t i) const { return m_bits[(m_head + i) & m_mask]; }
+};
+
+// 把最近orig_len位历史折叠成comp_len位, 每次分支O(1)更新:
+// 移入最新的一位, 消去移出窗口的一位, 再把溢出的最高位循环到最低位.
+// 第j新的历史位最终位于第 j % comp_len 位.
+class FoldedHistory
+{
+    UINT32 m_comp;
+    size_t m_orig_len;
+    size_t m_comp_len;
+    size_t m_outpoint;
+
+    public:
+        FoldedHistory() : m_comp(0), m_orig_len(0), m_comp_len(1), m_outpoint(0) {}
+
+        // comp_len为0时折叠结果恒为0 (如标签宽度为1时的m_fold_tag1)
+        void init(size_t orig_len, size_t comp_len)
+        {
+            m_comp = 0;
+            m_orig_len = orig_len;
+            m_comp_len = comp_len;
+            m_outpoint = comp_len ? orig_len % comp_len : 0;
+        }
+
+        // Call right after GlobalHistory::push
+        void update(const GlobalHistory& hist)
+        {
+            if (m_comp_len == 0) return;
+            m_comp = (m_comp << 1) | hist[0];
+            m_comp ^= (UINT32)hist[m_orig_len] << m_outpoint;
+            m_comp ^= m_comp >> m_comp_len;
+            m_comp &= (1u << m_comp_len) - 1;
+        }
+
+        UINT32 getVal() { return m_comp; }
+};
+
+// Hash functions
+inline  UINT128 f_xor(UINT128 a, UINT128 b) { return a ^ b; }
+inline UINT128 f_xor1(UINT128 a, UINT128 b) { return ~a ^ ~b; }
+inline UINT128 f_xnor(UINT128 a, UINT128 b) { return ~(a ^ ~b); }
+
+
+
+// Base class of all predictors
+class BranchPredictor
+{
+    public:
+        BranchPredictor() {}
+        virtual ~BranchPredictor() {}
+        virtual bool predict(ADDRINT addr) { return false; };
+        virtual void update(bool takenActually, bool takenPredicted, ADDRINT addr) {};
+};
+
+
+
+/* ===================================================================== */
+/* BHT-based branch predictor                                            */
+/* ===================================================================== */
+class BHTPredictor: public BranchPredictor
+{
+    size_t m_entries_log;
+    SatCntTable m_scnt;                 // BHT
+    
+    public:
+        // Constructor
+        // param:   entry_num_log:  BHT行数的对数
+        //          scnt_width:     饱和计数器的位数, 默认值为2
+        BHTPredictor(size_t entry_num_log, size_t scnt_width = 2)
+        : m_entries_log(entry_num_log), m_scnt(entry_num_log, scnt_width)
+        {
+        }
+
+        BOOL predict(ADDRINT addr)
+        {
+            // TODO: Produce prediction according to BHT
+            return m_scnt.isTaken(truncate(addr, m_entries_log));
+        }
+
+        void update(BOOL takenActually, BOOL takenPredicted, ADDRINT addr)
+        {
+            // TODO: Update BHT according to branch results and prediction
+            //预测跳转
+            if(takenPredicted){
+                //真跳
+                if(takenActually){
+                    m_scnt.increase(truncate(addr, m_entries_log));
+                }
+                else{
+                    if(m_scnt.getVal(truncate(addr, m_entries_log)) == 2){
+                        m_scnt.decrease(truncate(addr, m_entries_log));
+                        m_scnt.decrease(truncate(addr, m_entries_log));
+                        
+                    }
+                    else{
+                        m_scnt.decrease(truncate(addr, m_entries_log)); 
+                    }
+                }
+            }
+            else{
+                if(takenActually){
+                    if(m_scnt.getVal(truncate(addr, m_entries_log)) == 1){
+                        m_scnt.increase(truncate(addr, m_entries_log));
+                        m_scnt.increase(truncate(addr, m_entries_log));
+
+                    }
+                    else{
+                        m_scnt.increase(truncate(addr, m_entries_log));                        
+                    }
+                }
+                else{
+                    m_scnt.decrease(truncate(addr, m_entries_log));
+                }
+            }
+        }
+};
+
+/* ===================================================================== */
+/* Global-history-based branch predictor                                 */
+/* ===================================================================== */
+template<UINT128 (*hash)(UINT128 addr, UINT128 history)>
+class GlobalHistoryPredictor: public BranchPredictor
+{
+    GlobalHistory* m_ghr;               // GHR
+    FoldedHistory m_folded;             // 折叠到PHT下标宽度的GHR
+    SatCntTable m_scnt;                 // PHT中的分支历史字段
+    size_t m_entries_log;                   // PHT行数的对数
+    size_t m_ghr_width;
+    
+    public:
+        // Constructor
+        // param:   ghr_width:      Width of GHR
+        //          entry_num_log:  PHT表行数的对数
+        //          scnt_width:     饱和计数器的位数, 默认值为2
+        GlobalHistoryPredictor(size_t ghr_width, size_t entry_num_log, size_t scnt_width = 2)
+        : m_scnt(entry_num_log, scnt_width)
+        {
+            // TODO:
+            m_entries_log = entry_num_log;
+
+            m_ghr = new GlobalHistory(ghr_width);
+            m_folded.init(ghr_width, entry_num_log);
+            m_ghr_width = ghr_width;
+
+        }
+
+        // Destructor
+        ~GlobalHistoryPredictor()
+        {
+            // TODO
+            delete m_ghr;
+        }
+
+        // Only for TAGE: return a tag according to the specificed address
+        UINT128 get_tag(ADDRINT addr)
+        {
+            // TODO
+           return truncate((*hash)(addr, get_ghr()), m_entries_log);
+        }
+
+        // Only for TAGE: return GHR's value (folded into entry_num_log bits)
+        UINT128 get_ghr()
+        {
+            // TODO
+            return m_folded.getVal();
+        }
+
+        UINT128 getMid(){
+            return m_ghr_width;
+        }
+
+        // Only for TAGE: reset a saturating counter to default value (which is weak taken)
+        void reset_ctr(ADDRINT addr)
+        {
+            // TODO
+            m_scnt.reset(get_tag(addr));
+        }
+
+        bool predict(ADDRINT addr)
+        {
+            // TODO: Produce prediction according to GHR and PHT
+            return m_scnt.isTaken(get_tag(addr));
+        }
+
+        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
+        {
+            // TODO: Update GHR and PHT according to branch results and prediction
+             //预测跳转
+
+             UINT128 getaddr = get_tag(addr);
+            if(takenPredicted){
+                //真跳
+                if(takenActually){
+                    m_scnt.increase(getaddr);
+                }
+                else{
+                    if(m_scnt.getVal(getaddr) == 2){
+                        m_scnt.decrease(getaddr);
+                        m_scnt.decrease(getaddr);
+                        
+                    }
+                    else{
+                        m_scnt.decrease(getaddr); 
+                    }
+                }
+            }
+            else{
+                if(takenActually){
+                    if(m_scnt.getVal(getaddr) == 1){
+                        m_scnt.increase(getaddr);
+                        m_scnt.increase(getaddr);
+
+                    }
+                    else{
+                        m_scnt.increase(getaddr);                        
+                    }
+                }
+                else{
+                    m_scnt.decrease(getaddr);
+                }
+            }
+            //更新ghr
+            m_ghr->push(takenActually);
+            m_folded.update(*m_ghr);
+        }
+};
+
+/* ===================================================================== */
+/* Tournament predictor: Select output by global/local selection history */
+/* ===================================================================== */
+class TournamentPredictor: public BranchPredictor
+{
+    BranchPredictor* m_BPs[2];      // Sub-predictors
+    SaturatingCnt* m_gshr;          // Global select-history register
+
+    public:
+        TournamentPredictor(BranchPredictor* BP0, BranchPredictor* BP1, size_t gshr_width = 2)
+        {
+            // TODO
+            m_BPs[0] = BP0;
+            m_BPs[1] = BP1;
+            m_gshr = new SaturatingCnt(gshr_width);
+        }
+
+        ~TournamentPredictor()
+        {
+            // TODO
+            delete m_BPs[0];
+            delete m_BPs[1];
+        }
+
+        // TODO
+
+        bool predict(ADDRINT addr){
+            if(truncate(m_gshr->getVal()>> (m_gshr->getWidth() - 1), 1)){
+                return m_BPs[0]->predict(addr);
+            }
+            else{
+                return m_BPs[1]->predict(addr);
+            }
+
+        }
+
+        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
+        {
+            m_BPs[0]->update(takenActually, takenPredicted, addr);
+            m_BPs[1]->update(takenActually, takenPredicted, addr);
+            
+            if(m_BPs[0]->predict(addr) != m_BPs[1]->predict(addr)){
+                if(m_BPs[0]->predict(addr) == takenActually){
+                    m_gshr->decrease();
+                }
+                else{
+                    m_gshr->increase();
+                }
+            }
+        }
+};
+
+/* ===================================================================== */
+/* TArget GEometric history length Predictor                             */
+/* ===================================================================== */
+// T0为不带标签的BHT, T[1 : m_tnum - 1]为带部分标签的表, 历史长度按alpha几何增长 (不限于128位).
+// 每项: 部分标签, 有符号的预测计数器 (scnt_width位), 2位useful计数器.
+// hash1生成表的下标, hash2生成标签, 两者的历史输入都是把GHR折叠到相应宽度后的值.
+template<UINT128 (*hash1)(UINT128 pc, UINT128 ghr), UINT128 (*hash2)(UINT128 pc, UINT128 ghr)>
+class TAGEPredictor: public BranchPredictor
+{
+    struct TageEntry
+    {
+        UINT16 tag;
+        INT8 ctr;                   // >= 0 预测跳转
+        UINT8 u;                    // useful
+    };
+
+    const size_t m_tnum;            // 子预测器个数 (T[0 : m_tnum - 1])
+    const size_t m_entries_log;     // 子预测器T[1 : m_tnum - 1]的行数的对数
+    const size_t m_tag_width;       // 部分标签的位数
+    const INT8 m_ctr_max;           // 预测计数器的取值范围 [-m_ctr_max - 1, m_ctr_max]
+    BranchPredictor* m_T0;          // 基础预测器
+    TageEntry** m_T;                // 带标签的表, m_T[0]不使用
+    size_t* m_hist_len;             // 各表使用的历史长度
+    GlobalHistory* m_ghr;           // 全局历史, 长度为最长的历史长度
+    FoldedHistory* m_fold_idx;      // 各表的历史折叠到下标宽度
+    FoldedHistory* m_fold_tag0;     // 各表的历史折叠到标签宽度
+    FoldedHistory* m_fold_tag1;     // 各表的历史折叠到标签宽度减1
+
+    // 本次预测的中间结果, 供update使用
+    size_t* m_idx;
+    UINT16* m_tag;
+    size_t provider_indx;           // Provider's index of m_T (0: T0)
+    size_t altpred_indx;            // Alternate provider's index of m_T
+    bool m_provider_pred;
+    bool m_alt_pred;
+
+    INT8 m_use_alt_on_na;           // 新分配项 (弱计数器且u为0) 的预测不如备选预测时增大
+    const size_t m_rst_period;      // Reset period of usefulness
+    size_t m_rst_cnt;               // Reset counter
+    bool m_rst_msb;                 // 下一次老化清除u的高位还是低位
+    UINT32 m_rand;                  // 分配时随机选择的线性同余状态
+
+    size_t get_index(ADDRINT addr, size_t i)
+    {
+        UINT128 pc = addr ^ (addr >> (m_entries_log - i % m_entries_log));
+        return (size_t)((*hash1)(pc, m_fold_idx[i].getVal()) & ((1u << m_entries_log) - 1));
+    }
+
+    // 表项初始化为0, 标签0保留给无效项, 否则未分配过的项会与标签为0的分支误命中
+    UINT16 get_tag(ADDRINT addr, size_t i)
+    {
+        UINT128 h = m_fold_tag0[i].getVal() ^ ((UINT128)m_fold_tag1[i].getVal() << 1);
+        UINT16 tag = (UINT16)((*hash2)(addr, h) & ((1u << m_tag_width) - 1));
+        return tag ? tag : 1;
+    }
+
+    void ctr_update(INT8& ctr, bool taken)
+    {
+        if (taken && ctr < m_ctr_max) ctr++;
+        else if (!taken && ctr > -m_ctr_max - 1) ctr--;
+    }
+
+    bool is_weak(const TageEntry& e) { return e.ctr == 0 || e.ctr == -1; }
+
+    public:
+        // Constructor
+        // param:   tnum:               The number of sub-predictors
+        //          T0_entry_num_log:   子预测器T0的BHT行数的对数
+        //          T1ghr_len:          子预测器T1的GHR位宽
+        //          alpha:              各子预测器T[1 : m_tnum - 1]的GHR几何倍数关系
+        //          Tn_entry_num_log:   各子预测器T[1 : m_tnum - 1]的PHT行数的对数
+        //          scnt_width:         Width of saturating counter (3 by default)
+        //          rst_period:         Reset period of usefulness
+        //          tag_width:          部分标签的位数 (2到16, 标签0保留)
+        TAGEPredictor(size_t tnum, size_t T0_entry_num_log, size_t T1ghr_len, float alpha, size_t Tn_entry_num_log,
+                      size_t scnt_width = 3, size_t rst_period = 256*1024, size_t tag_width = 8)
+        : m_tnum(tnum), m_entries_log(Tn_entry_num_log),
+          m_tag_width(tag_width < 2 ? 2 : tag_width < 16 ? tag_width : 16),
+          m_ctr_max((1 << (scnt_width - 1)) - 1), provider_indx(0), altpred_indx(0),
+          m_provider_pred(false), m_alt_pred(false), m_use_alt_on_na(0),
+          m_rst_period(rst_period), m_rst_cnt(0), m_rst_msb(true), m_rand(1)
+        {
+            m_T0 = new BHTPredictor(T0_entry_num_log);
+            m_T = new TageEntry* [m_tnum];
+            m_hist_len = new size_t [m_tnum];
+            m_idx = new size_t [m_tnum];
+            m_tag = new UINT16 [m_tnum];
+            m_fold_idx = new FoldedHistory [m_tnum];
+            m_fold_tag0 = new FoldedHistory [m_tnum];
+            m_fold_tag1 = new FoldedHistory [m_tnum];
+
+            m_T[0] = NULL;
+            m_hist_len[0] = 0;
+            double ghr_size = T1ghr_len;
+            for (size_t i = 1; i < m_tnum; i++)
+            {
+                m_hist_len[i] = (size_t)(ghr_size + 0.5);
+                if (m_hist_len[i] <= m_hist_len[i - 1]) m_hist_len[i] = m_hist_len[i - 1] + 1;
+                ghr_size *= alpha;
+                m_fold_idx[i].init(m_hist_len[i], m_entries_log);
+                m_fold_tag0[i].init(m_hist_len[i], m_tag_width);
+                m_fold_tag1[i].init(m_hist_len[i], m_tag_width - 1);
+
+                m_T[i] = new TageEntry [1 << m_entries_log];
+                memset(m_T[i], 0, sizeof(TageEntry) * (1 << m_entries_log));
+            }
+            m_ghr = new GlobalHistory(m_hist_len[m_tnum - 1]);
+        }
+
+        ~TAGEPredictor()
+        {
+            for (size_t i = 1; i < m_tnum; i++) delete[] m_T[i];
+            delete[] m_T;
+            delete m_T0;
+            delete[] m_hist_len;
+            delete[] m_idx;
+            delete[] m_tag;
+            delete[] m_fold_idx;
+            delete[] m_fold_tag0;
+            delete[] m_fold_tag1;
+            delete m_ghr;
+        }
+
+        bool predict(ADDRINT addr)
+        {
+            provider_indx = 0;
+            altpred_indx = 0;
+            for (size_t i = m_tnum - 1; i >= 1; i--)
+            {
+                m_idx[i] = get_index(addr, i);
+                m_tag[i] = get_tag(addr, i);
+                if (m_T[i][m_idx[i]].tag != m_tag[i]) continue;
+                if (provider_indx == 0) provider_indx = i;
+                else if (altpred_indx == 0) altpred_indx = i;
+            }
+
+            bool base_pred = m_T0->predict(addr);
+            m_alt_pred = altpred_indx ? m_T[altpred_indx][m_idx[altpred_indx]].ctr >= 0 : base_pred;
+            if (provider_indx == 0)
+            {
+                m_provider_pred = base_pred;
+                return base_pred;
+            }
+
+            TageEntry& e = m_T[provider_indx][m_idx[provider_indx]];
+            m_provider_pred = e.ctr >= 0;
+            if (is_weak(e) && e.u == 0 && m_use_alt_on_na >= 0)
+                return m_alt_pred;
+            return m_provider_pred;
+        }
+
+        // Confidence of the last prediction: 0 弱计数器或来自T0, 1 中等, 2 计数器饱和
+        UINT32 getConfidence()
+        {
+            if (provider_indx == 0) return 0;
+            const TageEntry& e = m_T[provider_indx][m_idx[provider_indx]];
+            if (is_weak(e)) return 0;
+            return (e.ctr == m_ctr_max || e.ctr == -m_ctr_max - 1) ? 2 : 1;
+        }
+
+        // Index of the table that provided the last prediction (0: T0)
+        size_t getProvider() { return provider_indx; }
+
+        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
+        {
+            if (provider_indx != 0)
+            {
+                TageEntry& e = m_T[provider_indx][m_idx[provider_indx]];
+                bool new_entry = is_weak(e) && e.u == 0;
+
+                // 新分配项与备选预测不同时, 学习应该相信哪一个
+                if (new_entry && m_provider_pred != m_alt_pred)
+                {
+                    if (m_alt_pred == takenActually) { if (m_use_alt_on_na < 7) m_use_alt_on_na++; }
+                    else if (m_use_alt_on_na > -8) m_use_alt_on_na--;
+                }
+
+                // 提供者的u: 只有它与备选预测不同时才能体现其作用
+                if (m_provider_pred != m_alt_pred)
+                {
+                    if (m_provider_pred == takenActually) { if (e.u < 3) e.u++; }
+                    else if (e.u > 0) e.u--;
+                }
+
+                ctr_update(e.ctr, takenActually);
+                // 新分配的提供者还不可靠, 同时训练备选预测器
+                if (new_entry)
+                {
+                    if (altpred_indx) ctr_update(m_T[altpred_indx][m_idx[altpred_indx]].ctr, takenActually);
+                    else m_T0->update(takenActually, m_alt_pred, addr);
+                }
+            }
+            else
+            {
+                m_T0->update(takenActually, m_provider_pred, addr);
+            }
+
+            // Entry replacement: 预测错误时在更长历史的表中分配一项, 没有u为0的项时衰减它们的u
+            if (takenActually != takenPredicted && provider_indx < m_tnum - 1)
+            {
+                size_t candidates[2];
+                size_t cand_num = 0;
+                for (size_t i = provider_indx + 1; i < m_tnum && cand_num < 2; i++)
+                    if (m_T[i][m_idx[i]].u == 0) candidates[cand_num++] = i;
+
+                if (cand_num == 0)
+                {
+                    for (size_t i = provider_indx + 1; i < m_tnum; i++)
+                        m_T[i][m_idx[i]].u--;
+                }
+                else
+                {
+                    // 以2:1的概率选择历史较短的候选, 避免总是与同一张表冲突
+                    m_rand = m_rand * 1103515245 + 12345;
+                    size_t i = (cand_num == 2 && (m_rand >> 16) % 3 == 0) ? candidates[1] : candidates[0];
+                    m_T[i][m_idx[i]].tag = m_tag[i];
+                    m_T[i][m_idx[i]].ctr = takenActually ? 0 : -1;
+                    m_T[i][m_idx[i]].u = 0;
+                }
+            }
+
+            // Graceful aging: 周期性地交替清除所有表项u的高位和低位
+            if (++m_rst_cnt >= m_rst_period)
+            {
+                UINT8 keep = m_rst_msb ? 1 : 2;
+                for (size_t i = 1; i < m_tnum; i++)
+                    for (size_t j = 0; j < ((size_t)1 << m_entries_log); j++)
+                        m_T[i][j].u &= keep;
+                m_rst_msb = !m_rst_msb;
+                m_rst_cnt = 0;
+            }
+
+            m_ghr->push(takenActually);
+            for (size_t i = 1; i < m_tnum; i++)
+            {
+                m_fold_idx[i].update(*m_ghr);
+                m_fold_tag0[i].update(*m_ghr);
+                m_fold_tag1[i].update(*m_ghr);
+            }
+        }
+};
+
+
+
+/* ===================================================================== */
+/* Hashed perceptron predictor                                           */
+/* ===================================================================== */
+// 全局历史按32位分段, 第s段对应历史位[32s, 32s + 32). 每段一张权重表, 一行是32个INT8权重,
+// 行号由PC与长度按alpha几何增长的折叠历史哈希得到 (第0段只用PC, 即经典感知器).
+// 输出 y = bias + sum(dot(W_s, h_s)), h为+1/-1; y >= 0 预测跳转.
+// 预测错误或|y| <= theta时训练; theta按O-GEHL的方法自适应调整.
+// 历史保存在写两份的+1/-1字节循环缓冲区中, 任何时刻最新的H位都是连续的, 可以直接向量化.
+// 点积和训练在编译时选择AVX2 / SSE4.1 / 标量实现 (用-mavx2或-msse4.1编译以启用SIMD).
+#define PERCEPTRON_SEG_WIDTH    32
+
+// dot(w, h) over one segment
+inline INT32 perceptron_dot(const INT8* w, const INT8* h)
+{
+#if defined(__AVX2__)
+    __m256i p = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i*)w), _mm256_loadu_si256((const __m256i*)h));
+    __m256i s16 = _mm256_maddubs_epi16(_mm256_set1_epi8(1), p);
+    __m256i s32 = _mm256_madd_epi16(s16, _mm256_set1_epi16(1));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(s32), _mm256_extracti128_si256(s32, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSE4_1__)
+    __m128i ones8 = _mm_set1_epi8(1), ones16 = _mm_set1_epi16(1);
+    __m128i p0 = _mm_sign_epi8(_mm_loadu_si128((const __m128i*)w), _mm_loadu_si128((const __m128i*)h));
+    __m128i p1 = _mm_sign_epi8(_mm_loadu_si128((const __m128i*)(w + 16)), _mm_loadu_si128((const __m128i*)(h + 16)));
+    __m128i s = _mm_add_epi32(_mm_madd_epi16(_mm_maddubs_epi16(ones8, p0), ones16),
+                              _mm_madd_epi16(_mm_maddubs_epi16(ones8, p1), ones16));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+#else
+    INT32 sum = 0;
+    for (size_t i = 0; i < PERCEPTRON_SEG_WIDTH; i++)
+        sum += w[i] * h[i];
+    return sum;
+#endif
+}
+
+// w += t * h with saturation to [-127, 127] (t = +1 if taken, -1 otherwise)
+inline void perceptron_train(INT8* w, const INT8* h, bool taken)
+{
+#if defined(__AVX2__)
+    __m256i d = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i*)h), _mm256_set1_epi8(taken ? 1 : -1));
+    __m256i v = _mm256_adds_epi8(_mm256_loadu_si256((const __m256i*)w), d);
+    _mm256_storeu_si256((__m256i*)w, _mm256_max_epi8(v, _mm256_set1_epi8(-127)));
+#elif defined(__SSE4_1__)
+    __m128i t = _mm_set1_epi8(taken ? 1 : -1), lo = _mm_set1_epi8(-127);
+    for (size_t i = 0; i < PERCEPTRON_SEG_WIDTH; i += 16)
+    {
+        __m128i d = _mm_sign_epi8(_mm_loadu_si128((const __m128i*)(h + i)), t);
+        __m128i v = _mm_adds_epi8(_mm_loadu_si128((const __m128i*)(w + i)), d);
+        _mm_storeu_si128((__m128i*)(w + i), _mm_max_epi8(v, lo));
+    }
+#else
+    for (size_t i = 0; i < PERCEPTRON_SEG_WIDTH; i++)
+    {
+        INT32 v = w[i] + (taken ? h[i] : -h[i]);
+        w[i] = (INT8)(v > 127 ? 127 : (v < -127 ? -127 : v));
+    }
+#endif
+}
+
+class HashedPerceptronPredictor: public BranchPredictor
+{
+    const size_t m_seg_num;         // 历史段数, 历史长度为 m_seg_num * 32
+    const size_t m_entries_log;     // 每张权重表行数的对数
+    INT8** m_W;                     // 各段的权重表, 每行PERCEPTRON_SEG_WIDTH个权重
+    INT8* m_bias;                   // 按PC索引的偏置权重
+    INT8* m_hist;                   // +1/-1历史, 长度2H, 每一位写两份
+    size_t m_hist_pos;              // 最新一位在m_hist中的位置
+    GlobalHistory* m_ghr;           // 供行号哈希使用的历史
+    FoldedHistory* m_fold;          // 各段行号使用的折叠历史
+
+    size_t* m_row;                  // 本次预测各段使用的行
+    size_t m_bias_row;
+    INT32 m_y;                      // 本次预测的输出
+
+    INT32 m_theta;                  // 训练阈值
+    INT32 m_tc;                     // 阈值调整计数器
+
+    public:
+        // Constructor
+        // param:   seg_num:        历史段数 (每段32位)
+        //          entry_num_log:  每张权重表行数的对数
+        //          idx_hist_len:   第1段行号使用的历史长度, 第0段只用PC
+        //          alpha:          各段行号历史长度的几何倍数关系
+        HashedPerceptronPredictor(size_t seg_num = 4, size_t entry_num_log = 10, size_t idx_hist_len = 8, float alpha = 2)
+        : m_seg_num(seg_num), m_entries_log(entry_num_log), m_hist_pos(0), m_bias_row(0), m_y(0), m_tc(0)
+        {
+            size_t H = m_seg_num * PERCEPTRON_SEG_WIDTH;
+            m_W = new INT8* [m_seg_num];
+            for (size_t s = 0; s < m_seg_num; s++)
+            {
+                m_W[s] = new INT8 [(1 << m_entries_log) * PERCEPTRON_SEG_WIDTH];
+                memset(m_W[s], 0, (1 << m_entries_log) * PERCEPTRON_SEG_WIDTH);
+            }
+            m_bias = new INT8 [1 << m_entries_log];
+            memset(m_bias, 0, 1 << m_entries_log);
+            m_hist = new INT8 [2 * H];
+            memset(m_hist, -1, 2 * H);
+            m_row = new size_t [m_seg_num];
+
+            m_fold = new FoldedHistory [m_seg_num];
+            double len = idx_hist_len;
+            for (size_t s = 1; s < m_seg_num; s++, len *= alpha)
+                m_fold[s].init((size_t)(len + 0.5), m_entries_log);
+            m_ghr = new GlobalHistory((size_t)(len + 0.5));
+
+            m_theta = (INT32)(1.93 * H + 14);
+        }
+
+        ~HashedPerceptronPredictor()
+        {
+            for (size_t s = 0; s < m_seg_num; s++) delete[] m_W[s];
+            delete[] m_W;
+            delete[] m_bias;
+            delete[] m_hist;
+            delete[] m_row;
+            delete[] m_fold;
+            delete m_ghr;
+        }
+
+        bool predict(ADDRINT addr)
+        {
+            size_t mask = (1 << m_entries_log) - 1;
+            ADDRINT pc = addr ^ (addr >> m_entries_log);
+            const INT8* h = m_hist + m_hist_pos;
+
+            m_bias_row = pc & mask;
+            m_y = m_bias[m_bias_row];
+            for (size_t s = 0; s < m_seg_num; s++)
+            {
+                m_row[s] = (pc ^ m_fold[s].getVal() ^ (s << (m_entries_log / 2))) & mask;
+                m_y += perceptron_dot(m_W[s] + m_row[s] * PERCEPTRON_SEG_WIDTH, h + s * PERCEPTRON_SEG_WIDTH);
+            }
+            return m_y >= 0;
+        }
+
+        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
+        {
+            bool mispredicted = (m_y >= 0) != takenActually;
+            INT32 mag = m_y >= 0 ? m_y : -m_y;
+
+            if (mispredicted || mag <= m_theta)
+            {
+                const INT8* h = m_hist + m_hist_pos;
+                INT8& b = m_bias[m_bias_row];
+                if (takenActually && b < 127) b++;
+                else if (!takenActually && b > -127) b--;
+                for (size_t s = 0; s < m_seg_num; s++)
+                    perceptron_train(m_W[s] + m_row[s] * PERCEPTRON_SEG_WIDTH, h + s * PERCEPTRON_SEG_WIDTH, takenActually);
+
+                // 自适应阈值: 预测错误多则增大theta, 低置信度的正确预测多则减小
+                if (mispredicted && ++m_tc >= 63)
+                {
+                    m_theta++;
+                    m_tc = 0;
+                }
+                else if (!mispredicted && --m_tc <= -64)
+                {
+                    if (m_theta > 0) m_theta--;
+                    m_tc = 0;
+                }
+            }
+
+            size_t H = m_seg_num * PERCEPTRON_SEG_WIDTH;
+            m_hist_pos = (m_hist_pos + H - 1) % H;
+            m_hist[m_hist_pos] = m_hist[m_hist_pos + H] = takenActually ? 1 : -1;
+            m_ghr->push(takenActually);
+            for (size_t s = 1; s < m_seg_num; s++)
+                m_fold[s].update(*m_ghr);
+        }
+};
+
+/* ===================================================================== */
+/* TAGE-SC-L: TAGE + statistical corrector + loop predictor              */
+/* ===================================================================== */
+#define LOOP_MAX_ITER   ((1 << 14) - 1)
+#define LOOP_CONF_MAX   3
+#define LOOP_AGE_MAX    7
+
+// 循环预测器: 学习固定的循环次数. 表项记录循环体的方向dir, 上一次的循环次数past_iter
+// 和本次已执行的次数cur_iter; 同一次数连续出现LOOP_CONF_MAX次后才给出预测, 在第past_iter次预测退出.
+// TAGE预测错误且未命中时分配 (假定错误发生在循环出口), 预测错误或次数改变时释放.
+// 无法分配时以1/8的概率衰减同组各项的age, 使难预测的分支不能很快挤掉正在学习的循环.
+class LoopPredictor
+{
+    struct LoopEntry
+    {
+        UINT16 tag;                 // 0表示空项
+        UINT16 past_iter;
+        UINT16 cur_iter;
+        UINT8 conf;
+        UINT8 age;                  // 替换保护, 分配失败时递减
+        bool dir;
+    };
+
+    const size_t m_set_num_log;
+    const size_t m_assoc;
+    LoopEntry* m_entries;
+    UINT32 m_rand;                  // 衰减age时随机选择的线性同余状态
+
+    // 本次预测的中间结果, 供update使用
+    LoopEntry* m_set;
+    LoopEntry* m_hit;
+    UINT16 m_tag;
+    bool m_valid;
+    bool m_pred;
+
+    public:
+        LoopPredictor(size_t set_num_log = 4, size_t assoc = 4)
+        : m_set_num_log(set_num_log), m_assoc(assoc), m_rand(1), m_set(NULL), m_hit(NULL), m_tag(0),
+          m_valid(false), m_pred(false)
+        {
+            m_entries = new LoopEntry [(1 << m_set_num_log) * m_assoc];
+            memset(m_entries, 0, sizeof(LoopEntry) * (1 << m_set_num_log) * m_assoc);
+        }
+
+        ~LoopPredictor() { delete[] m_entries; }
+
+        bool predict(ADDRINT addr)
+        {
+            m_set = m_entries + ((addr ^ (addr >> 2) ^ (addr >> (m_set_num_log + 2))) & ((1 << m_set_num_log) - 1)) * m_assoc;
+            m_tag = (UINT16)(addr >> m_set_num_log);
+            if (m_tag == 0) m_tag = 1;
+
+            m_hit = NULL;
+            for (size_t w = 0; w < m_assoc; w++)
+                if (m_set[w].tag == m_tag) m_hit = m_set + w;
+
+            m_valid = m_hit && m_hit->conf == LOOP_CONF_MAX;
+            m_pred = m_hit ? (m_hit->cur_iter + 1 == m_hit->past_iter ? !m_hit->dir : m_hit->dir) : false;
+            return m_pred;
+        }
+
+        // The prediction of the last predict() is confident enough to be used
+        bool isValid() { return m_valid; }
+
+        // tage_pred: TAGE在这条分支上的预测, 用于决定分配和增加age
+        void update(bool takenActually, bool tage_pred)
+        {
+            if (m_hit)
+            {
+                LoopEntry& e = *m_hit;
+                if (m_valid)
+                {
+                    if (m_pred != takenActually)
+                    {
+                        memset(&e, 0, sizeof(LoopEntry));
+                        return;
+                    }
+                    if (m_pred != tage_pred && e.age < LOOP_AGE_MAX) e.age++;
+                }
+
+                if (++e.cur_iter > LOOP_MAX_ITER)
+                {
+                    memset(&e, 0, sizeof(LoopEntry));
+                    return;
+                }
+                if (takenActually != e.dir)
+                {
+                    // 循环出口: 次数与上一次相同则增加置信度, 第一次学习则记下次数, 否则放弃
+                    if (e.cur_iter == e.past_iter)
+                    {
+                        if (e.conf < LOOP_CONF_MAX) e.conf++;
+                    }
+                    else if (e.past_iter == 0)
+                        e.past_iter = e.cur_iter;
+                    else
+                    {
+                        memset(&e, 0, sizeof(LoopEntry));
+                        return;
+                    }
+                    e.cur_iter = 0;
+                }
+            }
+            else if (takenActually != tage_pred)
+            {
+                for (size_t w = 0; w < m_assoc; w++)
+                {
+                    if (m_set[w].age == 0)
+                    {
+                        LoopEntry& e = m_set[w];
+                        e.tag = m_tag;
+                        e.past_iter = 0;
+                        e.cur_iter = 0;
+                        e.conf = 0;
+                        e.age = LOOP_AGE_MAX;
+                        e.dir = !takenActually;
+                        return;
+                    }
+                }
+                m_rand = m_rand * 1103515245 + 12345;
+                if ((m_rand >> 16) % 8 == 0)
+                    for (size_t w = 0; w < m_assoc; w++)
+                        m_set[w].age--;
+            }
+        }
+};
+
+// 统计校正器: 若干张以PC和不同长度全局历史为下标的6位有符号计数器表 (GEHL),
+// 表0以PC, TAGE的预测和置信度为下标, 学习TAGE在这条分支上的系统性偏差.
+// 总和与TAGE的预测相反且绝对值超过阈值时推翻TAGE (TAGE高置信度时阈值加倍).
+// 训练和阈值自适应与感知器相同.
+class StatisticalCorrector
+{
+    const size_t m_tnum;
+    const size_t m_entries_log;
+    INT8** m_T;
+    GlobalHistory* m_ghr;
+    FoldedHistory* m_fold;          // m_fold[0]不使用
+    size_t* m_idx;
+    INT32 m_sum;
+    INT32 m_theta;
+    INT32 m_tc;
+
+    public:
+        // Constructor
+        // param:   tnum:               表的个数, 包括表0
+        //          entries_log:        每张表的行数的对数
+        //          min_hist, max_hist: 表1和表tnum-1的历史长度, 中间按几何级数分布
+        StatisticalCorrector(size_t tnum = 6, size_t entries_log = 10, size_t min_hist = 4, size_t max_hist = 40)
+        : m_tnum(tnum < 2 ? 2 : tnum), m_entries_log(entries_log), m_sum(0), m_theta(m_tnum * 2), m_tc(0)
+        {
+            m_T = new INT8* [m_tnum];
+            m_idx = new size_t [m_tnum];
+            m_fold = new FoldedHistory [m_tnum];
+            for (size_t i = 0; i < m_tnum; i++)
+            {
+                m_T[i] = new INT8 [1 << m_entries_log];
+                memset(m_T[i], 0, 1 << m_entries_log);
+            }
+
+            double ratio = m_tnum > 2 ? pow((double)max_hist / min_hist, 1.0 / (m_tnum - 2)) : 1;
+            double len = min_hist;
+            size_t last = 0;
+            for (size_t i = 1; i < m_tnum; i++, len *= ratio)
+            {
+                size_t hist_len = (size_t)(len + 0.5);
+                if (hist_len <= last) hist_len = last + 1;
+                m_fold[i].init(hist_len, m_entries_log);
+                last = hist_len;
+            }
+            m_ghr = new GlobalHistory(last);
+        }
+
+        ~StatisticalCorrector()
+        {
+            for (size_t i = 0; i < m_tnum; i++) delete[] m_T[i];
+            delete[] m_T;
+            delete[] m_idx;
+            delete[] m_fold;
+            delete m_ghr;
+        }
+
+        // conf: TAGE的置信度 (0-2), 返回最终预测
+        bool predict(ADDRINT addr, bool tage_pred, UINT32 conf)
+        {
+            size_t mask = (1 << m_entries_log) - 1;
+            ADDRINT pc = addr ^ (addr >> m_entries_log);
+
+            m_idx[0] = ((pc << 3) | (tage_pred << 2) | conf) & mask;
+            m_sum = 2 * m_T[0][m_idx[0]] + 1;
+            for (size_t i = 1; i < m_tnum; i++)
+            {
+                m_idx[i] = (pc ^ m_fold[i].getVal() ^ (i << (m_entries_log / 2))) & mask;
+                m_sum += 2 * m_T[i][m_idx[i]] + 1;
+            }
+
+            INT32 mag = m_sum >= 0 ? m_sum : -m_sum;
+            if ((m_sum >= 0) != tage_pred && mag > (conf == 2 ? 2 * m_theta : m_theta))
+                return m_sum >= 0;
+            return tage_pred;
+        }
+
+        void update(bool takenActually)
+        {
+            bool mispredicted = (m_sum >= 0) != takenActually;
+            INT32 mag = m_sum >= 0 ? m_sum : -m_sum;
+
+            if (mispredicted || mag <= m_theta)
+            {
+                for (size_t i = 0; i < m_tnum; i++)
+                {
+                    INT8& c = m_T[i][m_idx[i]];
+                    if (takenActually && c < 31) c++;
+                    else if (!takenActually && c > -32) c--;
+                }
+
+                if (mispredicted && ++m_tc >= 63)
+                {
+                    m_theta++;
+                    m_tc = 0;
+                }
+                else if (!mispredicted && --m_tc <= -64)
+                {
+                    if (m_theta > 0) m_theta--;
+                    m_tc = 0;
+                }
+            }
+
+            m_ghr->push(takenActually);
+            for (size_t i = 1; i < m_tnum; i++)
+                m_fold[i].update(*m_ghr);
+        }
+};
+
+// TAGE的预测先经过统计校正器, 循环预测器有把握且以往比前者更准时最终采用循环预测器.
+class TAGESCLPredictor: public BranchPredictor
+{
+    TAGEPredictor<f_xor, f_xor1>* m_tage;
+    StatisticalCorrector m_sc;
+    LoopPredictor m_loop;
+    INT8 m_use_loop;                // 循环预测器与其它部件不同时它对的次数多则增大, >= 0时采用
+    bool m_tage_pred;
+    bool m_sc_pred;
+    bool m_loop_pred;
+
+    public:
+        // The parameters are those of TAGEPredictor
+        TAGESCLPredictor(size_t tnum, size_t T0_entry_num_log, size_t T1ghr_len, float alpha, size_t Tn_entry_num_log,
+                         size_t scnt_width = 3, size_t rst_period = 256*1024, size_t tag_width = 8)
+        : m_use_loop(0), m_tage_pred(false), m_sc_pred(false), m_loop_pred(false)
+        {
+            m_tage = new TAGEPredictor<f_xor, f_xor1>(tnum, T0_entry_num_log, T1ghr_len, alpha, Tn_entry_num_log,
+                                                      scnt_width, rst_period, tag_width);
+        }
+
+        ~TAGESCLPredictor() { delete m_tage; }
+
+        bool predict(ADDRINT addr)
+        {
+            m_tage_pred = m_tage->predict(addr);
+            m_sc_pred = m_sc.predict(addr, m_tage_pred, m_tage->getConfidence());
+            m_loop_pred = m_loop.predict(addr);
+            if (m_loop.isValid() && m_use_loop >= 0)
+                return m_loop_pred;
+            return m_sc_pred;
+        }
+
+        void update(bool takenActually, bool takenPredicted, ADDRINT addr)
+        {
+            if (m_loop.isValid() && m_loop_pred != m_sc_pred)
+            {
+                if (m_loop_pred == takenActually) { if (m_use_loop < 63) m_use_loop++; }
+                else if (m_use_loop > -64) m_use_loop--;
+            }
+
+            m_loop.update(takenActually, m_tage_pred);
+            m_sc.update(takenActually);
+            m_tage->update(takenActually, m_tage_pred, addr);
+        }
+};
+
+/* ===================================================================== */
+/* Branch target prediction: BTB, ITTAGE, RAS                            */
+/* ===================================================================== */
+// 组相联分支目标缓冲, 用完整PC作标签, LRU替换. 查不到时返回0.
+class BTB
+{
+    struct BTBEntry
+    {
+        ADDRINT pc;
+        ADDRINT target;
+        UINT64 lru;
+    };
+
+    const size_t m_set_num_log;
+    const size_t m_assoc;
+    BTBEntry* m_entries;
+    UINT64 m_time;
+
+    BTBEntry* get_set(ADDRINT pc)
+    {
+        return m_entries + ((pc ^ (pc >> m_set_num_log)) & ((1ul << m_set_num_log) - 1)) * m_assoc;
+    }
+
+    public:
+        BTB(size_t set_num_log = 9, size_t assoc = 4) : m_set_num_log(set_num_log), m_assoc(assoc), m_time(0)
+        {
+            m_entries = new BTBEntry [(1ul << m_set_num_log) * m_assoc];
+            memset(m_entries, 0, sizeof(BTBEntry) * (1ul << m_set_num_log) * m_assoc);
+        }
+
+        ~BTB() { delete[] m_entries; }
+
+        ADDRINT lookup(ADDRINT pc)
+        {
+            BTBEntry* set = get_set(pc);
+            for (size_t w = 0; w < m_assoc; w++)
+                if (set[w].pc == pc)
+                {
+                    set[w].lru = ++m_time;
+                    return set[w].target;
+                }
+            return 0;
+        }
+
+        void update(ADDRINT pc, ADDRINT target)
+        {
+            BTBEntry* set = get_set(pc);
+            BTBEntry* victim = set;
+            for (size_t w = 0; w < m_assoc; w++)
+            {
+                if (set[w].pc == pc) { victim = set + w; break; }
+                if (set[w].lru < victim->lru) victim = set + w;
+            }
+            victim->pc = pc;
+            victim->target = target;
+            victim->lru = ++m_time;
+        }
+};
+
+// 返回地址栈: 循环缓冲区, 栈满时压栈覆盖最老的项 (溢出), 栈空时弹栈预测失败 (下溢)
+class ReturnAddressStack
+{
+    const size_t m_depth;
+    ADDRINT* m_stack;
+    size_t m_top;                   // 下一次压栈的位置
+    size_t m_num;                   // 有效项数, 不超过m_depth
+
+    public:
+        UINT64 m_overflows;
+        UINT64 m_underflows;
+
+        ReturnAddressStack(size_t depth = 16)
+        : m_depth(depth), m_top(0), m_num(0), m_overflows(0), m_underflows(0)
+        {
+            m_stack = new ADDRINT [m_depth];
+        }
+
+        ~ReturnAddressStack() { delete[] m_stack; }
+
+        void push(ADDRINT ret_addr)
+        {
+            m_stack[m_top] = ret_addr;
+            m_top = (m_top + 1) % m_depth;
+            if (m_num < m_depth) m_num++;
+            else m_overflows++;
+        }
+
+        ADDRINT pop()
+        {
+            if (m_num == 0)
+            {
+                m_underflows++;
+                return 0;
+            }
+            m_num--;
+            m_top = (m_top + m_depth - 1) % m_depth;
+            return m_stack[m_top];
+        }
+};
+
+// ITTAGE: 结构与TAGEPredictor相同, 表项保存目标地址和2位置信度而不是方向计数器.
+// 基础预测器是以PC为下标的无标签目标表 (即上一次的目标). 历史由调用者通过pushHistory更新:
+// 条件分支压入方向, 间接分支压入目标地址的两位 (路径历史).
+class ITTAGEPredictor
+{
+    struct ITTageEntry
+    {
+        UINT16 tag;
+        UINT8 ctr;                  // 置信度 [0, 3]
+        UINT8 u;                    // useful [0, 1]
+        ADDRINT target;
+    };
+
+    const size_t m_tnum;            // 表的个数 (T[0 : m_tnum - 1]), T[0]为基础预测器
+    const size_t m_entries_log;
+    const size_t m_base_log;
+    const size_t m_tag_width;
+    ADDRINT* m_base;
+    ITTageEntry** m_T;
+    size_t* m_hist_len;
+    GlobalHistory* m_ghr;
+    FoldedHistory* m_fold_idx;
+    FoldedHistory* m_fold_tag0;
+    FoldedHistory* m_fold_tag1;
+
+    // 本次预测的中间结果, 供update使用
+    size_t* m_idx;
+    UINT16* m_tag;
+    size_t m_provider;
+    size_t m_alt;
+    ADDRINT m_provider_pred;
+    ADDRINT m_alt_pred;
+    ADDRINT m_pred;
+
+    const size_t m_rst_period;
+    size_t m_rst_cnt;
+    UINT32 m_rand;
+
+    size_t get_index(ADDRINT addr, size_t i)
+    {
+        UINT64 pc = addr ^ (addr >> (m_entries_log - i % m_entries_log));
+        return (pc ^ m_fold_idx[i].getVal()) & ((1ul << m_entries_log) - 1);
+    }
+
+    // 标签0保留给从未分配过的 (全0) 表项, 与TAGEPredictor相同
+    UINT16 get_tag(ADDRINT addr, size_t i)
+    {
+        UINT64 h = m_fold_tag0[i].getVal() ^ ((UINT64)m_fold_tag1[i].getVal() << 1);
+        UINT16 tag = (UINT16)((addr ^ (addr >> m_tag_width) ^ h) & ((1u << m_tag_width) - 1));
+        return tag ? tag : 1;
+    }
+
+    public:
+        // Constructor
+        // param:   tnum:               表的个数, 包括基础预测器
+        //          entries_log:        各带标签表的行数的对数
+        //          min_hist, max_hist: 最短和最长的历史长度, 中间按几何级数分布
+        //          base_log:           基础目标表的行数的对数
+        //          tag_width:          部分标签的位数 (2到16, 标签0保留)
+        ITTAGEPredictor(size_t tnum = 7, size_t entries_log = 9, size_t min_hist = 4, size_t max_hist = 128,
+                        size_t base_log = 10, size_t tag_width = 9, size_t rst_period = 256*1024)
+        : m_tnum(tnum < 2 ? 2 : tnum), m_entries_log(entries_log), m_base_log(base_log),
+          m_tag_width(tag_width < 2 ? 2 : tag_width < 16 ? tag_width : 16), m_provider(0), m_alt(0),
+          m_provider_pred(0), m_alt_pred(0), m_pred(0), m_rst_period(rst_period), m_rst_cnt(0), m_rand(1)
+        {
+            m_base = new ADDRINT [1 << m_base_log];
+            memset(m_base, 0, sizeof(ADDRINT) * (1 << m_base_log));
+            m_T = new ITTageEntry* [m_tnum];
+            m_hist_len = new size_t [m_tnum];
+            m_idx = new size_t [m_tnum];
+            m_tag = new UINT16 [m_tnum];
+            m_fold_idx = new FoldedHistory [m_tnum];
+            m_fold_tag0 = new FoldedHistory [m_tnum];
+            m_fold_tag1 = new FoldedHistory [m_tnum];
+
+            m_T[0] = NULL;
+            m_hist_len[0] = 0;
+            double ratio = m_tnum > 2 ? pow((double)max_hist / min_hist, 1.0 / (m_tnum - 2)) : 1;
+            double len = min_hist;
+            for (size_t i = 1; i < m_tnum; i++, len *= ratio)
+            {
+                m_hist_len[i] = (size_t)(len + 0.5);
+                if (m_hist_len[i] <= m_hist_len[i - 1]) m_hist_len[i] = m_hist_len[i - 1] + 1;
+                m_fold_idx[i].init(m_hist_len[i], m_entries_log);
+                m_fold_tag0[i].init(m_hist_len[i], m_tag_width);
+                m_fold_tag1[i].init(m_hist_len[i], m_tag_width - 1);
+
+                m_T[i] = new ITTageEntry [1 << m_entries_log];
+                memset(m_T[i], 0, sizeof(ITTageEntry) * (1 << m_entries_log));
+            }
+            m_ghr = new GlobalHistory(m_hist_len[m_tnum - 1]);
+        }
+
+        ~ITTAGEPredictor()
+        {
+            for (size_t i = 1; i < m_tnum; i++) delete[] m_T[i];
+            delete[] m_T;
+            delete[] m_base;
+            delete[] m_hist_len;
+            delete[] m_idx;
+            delete[] m_tag;
+            delete[] m_fold_idx;
+            delete[] m_fold_tag0;
+            delete[] m_fold_tag1;
+            delete m_ghr;
+        }
+
+        ADDRINT predict(ADDRINT addr)
+        {
+            m_provider = 0;
+            m_alt = 0;
+            for (size_t i = m_tnum - 1; i >= 1; i--)
+            {
+                m_idx[i] = get_index(addr, i);
+                m_tag[i] = get_tag(addr, i);
+                if (m_T[i][m_idx[i]].tag != m_tag[i]) continue;
+                if (m_provider == 0) m_provider = i;
+                else if (m_alt == 0) m_alt = i;
+            }
+
+            m_idx[0] = (addr ^ (addr >> m_base_log)) & ((1ul << m_base_log) - 1);
+            ADDRINT base_pred = m_base[m_idx[0]];
+            m_alt_pred = m_alt ? m_T[m_alt][m_idx[m_alt]].target : base_pred;
+            m_provider_pred = m_provider ? m_T[m_provider][m_idx[m_provider]].target : base_pred;
+
+            // 置信度为0的提供者 (刚分配或刚失败过) 让位于备选预测
+            m_pred = (m_provider && m_T[m_provider][m_idx[m_provider]].ctr == 0) ? m_alt_pred : m_provider_pred;
+            return m_pred;
+        }
+
+        // Train with the actual target of the branch last passed to predict()
+        void update(ADDRINT addr, ADDRINT target)
+        {
+            if (m_provider)
+            {
+                ITTageEntry& e = m_T[m_provider][m_idx[m_provider]];
+                if (e.target == target)
+                {
+                    if (e.ctr < 3) e.ctr++;
+                    if (m_alt_pred != target) e.u = 1;
+                }
+                else if (e.ctr > 0) e.ctr--;
+                else
+                {
+                    e.target = target;
+                    e.u = 0;
+                }
+                if (m_alt == 0) m_base[m_idx[0]] = target;
+            }
+            else
+                m_base[m_idx[0]] = target;
+
+            // 预测错误时在更长历史的表中分配一项
+            if (m_pred != target && m_provider < m_tnum - 1)
+            {
+                size_t candidates[2];
+                size_t cand_num = 0;
+                for (size_t i = m_provider + 1; i < m_tnum && cand_num < 2; i++)
+                    if (m_T[i][m_idx[i]].u == 0) candidates[cand_num++] = i;
+
+                if (cand_num == 0)
+                {
+                    for (size_t i = m_provider + 1; i < m_tnum; i++)
+                        m_T[i][m_idx[i]].u = 0;
+                }
+                else
+                {
+                    m_rand = m_rand * 1103515245 + 12345;
+                    size_t i = (cand_num == 2 && (m_rand >> 16) % 3 == 0) ? candidates[1] : candidates[0];
+                    m_T[i][m_idx[i]].tag = m_tag[i];
+                    m_T[i][m_idx[i]].target = target;
+                    m_T[i][m_idx[i]].ctr = 0;
+                    m_T[i][m_idx[i]].u = 0;
+                }
+            }
+
+            if (++m_rst_cnt >= m_rst_period)
+            {
+                for (size_t i = 1; i < m_tnum; i++)
+                    for (size_t j = 0; j < ((size_t)1 << m_entries_log); j++)
+                        m_T[i][j].u = 0;
+                m_rst_cnt = 0;
+            }
+        }
+
+        void pushHistory(bool bit)
+        {
+            m_ghr->push(bit);
+            for (size_t i = 1; i < m_tnum; i++)
+            {
+                m_fold_idx[i].update(*m_ghr);
+                m_fold_tag0[i].update(*m_ghr);
+                m_fold_tag1[i].update(*m_ghr);
+            }
+        }
+};
+
+// 分支目标预测部件: 条件分支的跳转目标和直接跳转/调用查BTB, 间接跳转/调用查ITTAGE
+// (同时统计只用BTB的结果作对照), 返回查RAS. 方向由方向预测器负责, 这里只统计目标.
+class BranchTargetUnit
+{
+    public:
+        enum { TGT_COND, TGT_DIRECT, TGT_INDIRECT, TGT_INDIRECT_BTB, TGT_RETURN, TGT_CLASS_NUM };
+
+        UINT64 m_lookups[TGT_CLASS_NUM];
+        UINT64 m_misses[TGT_CLASS_NUM];
+
+        BranchTargetUnit(size_t btb_set_num_log = 9, size_t btb_assoc = 4, size_t ras_depth = 16)
+        : m_btb(btb_set_num_log, btb_assoc), m_ras(ras_depth)
+        {
+            memset(m_lookups, 0, sizeof(m_lookups));
+            memset(m_misses, 0, sizeof(m_misses));
+        }
+
+        // size: 指令长度, 调用指令的返回地址为pc + size
+        void process(ADDRINT pc, ADDRINT target, bool taken, UINT32 type, UINT32 size)
+        {
+            switch (type)
+            {
+            case BR_COND:
+                if (taken) lookupBTB(TGT_COND, pc, target);
+                m_ittage.pushHistory(taken);
+                break;
+            case BR_JUMP:
+            case BR_CALL:
+                lookupBTB(TGT_DIRECT, pc, target);
+                break;
+            case BR_JUMP_IND:
+            case BR_CALL_IND:
+            {
+                count(TGT_INDIRECT, m_ittage.predict(pc) == target);
+                m_ittage.update(pc, target);
+                lookupBTB(TGT_INDIRECT_BTB, pc, target);
+                m_ittage.pushHistory((target >> 2) & 1);
+                m_ittage.pushHistory((target >> 3) & 1);
+                break;
+            }
+            case BR_RET:
+                count(TGT_RETURN, m_ras.pop() == target);
+                break;
+            }
+            if (type == BR_CALL || type == BR_CALL_IND)
+                m_ras.push(pc + size);
+        }
+
+        UINT64 getOverflows() { return m_ras.m_overflows; }
+        UINT64 getUnderflows() { return m_ras.m_underflows; }
+
+        // Print lookups, misses and MPKI (when ins_num is known) per branch class
+        void dump(std::ostream& os, UINT64 ins_num)
+        {
+            static const char* names[TGT_CLASS_NUM] = {
+                "cond taken (BTB)", "direct jmp/call (BTB)", "indirect (ITTAGE)", "indirect (BTB only)", "return (RAS)" };
+            os << std::endl << std::setw(24) << std::left << "target" << std::setw(14) << "lookups"
+               << std::setw(14) << "misses" << std::setw(10) << "miss%" << "MPKI" << std::endl;
+            for (UINT32 c = 0; c < TGT_CLASS_NUM; c++)
+            {
+                os << std::setw(24) << std::left << names[c] << std::setw(14) << m_lookups[c]
+                   << std::setw(14) << m_misses[c] << std::setw(10) << std::fixed << std::setprecision(2)
+                   << (m_lookups[c] ? 100.0 * m_misses[c] / m_lookups[c] : 0)
+                   << (ins_num ? 1000.0 * m_misses[c] / ins_num : 0) << std::endl;
+            }
+            os << "RAS overflows: " << m_ras.m_overflows << ", underflows: " << m_ras.m_underflows << std::endl;
+        }
+
+    private:
+        BTB m_btb;
+        ReturnAddressStack m_ras;
+        ITTAGEPredictor m_ittage;
+
+        void count(UINT32 c, bool hit)
+        {
+            m_lookups[c]++;
+            m_misses[c] += !hit;
+        }
+
+        void lookupBTB(UINT32 c, ADDRINT pc, ADDRINT target)
+        {
+            count(c, m_btb.lookup(pc) == target);
+            m_btb.update(pc, target);
+        }
+};
+
+// Parse the -targets argument "btb_set_num_log,btb_assoc,ras_depth"; return false unless
+// all three fields are present and in range (相联度和栈深度为0时BTB/RAS的下标会越界或除以0)
+inline bool parseTargetSpec(const char* spec, UINT32& btb_set_num_log, UINT32& btb_assoc, UINT32& ras_depth)
+{
+    UINT32 sets_log, assoc, depth;
+    char extra;
+    if (sscanf(spec, "%u,%u,%u%c", &sets_log, &assoc, &depth, &extra) != 3) return false;
+    if (sets_log > 24 || assoc == 0 || assoc > 64 || depth == 0 || depth > 65536) return false;
+    btb_set_num_log = sets_log;
+    btb_assoc = assoc;
+    ras_depth = depth;
+    return true;
+}
+
+/* ===================================================================== */
+/* Per-branch profile                                                    */
+/* ===================================================================== */
+// 以PC为键的开放寻址哈希表 (线性探测), 记录每条静态分支的执行次数, 预测错误次数和跳转次数.
+// PC为0的表项为空, 装载率超过3/4时容量翻倍.
+class BranchProfile
+{
+    public:
+        struct Entry
+        {
+            ADDRINT pc;
+            UINT64 exec;
+            UINT64 mispred;
+            UINT64 taken;
+        };
+
+        BranchProfile(size_t entry_num_log = 12) : m_mask((1ul << entry_num_log) - 1), m_used(0)
+        {
+            m_table = new Entry[m_mask + 1];
+            memset(m_table, 0, sizeof(Entry) * (m_mask + 1));
+        }
+
+        ~BranchProfile() { delete [] m_table; }
+
+        void record(ADDRINT pc, bool taken, bool mispredicted)
+        {
+            Entry& e = find(pc);
+            e.exec++;
+            e.mispred += mispredicted;
+            e.taken += taken;
+        }
+
+        size_t size() { return m_used; }
+
+        // The k entries with the most mispredictions, in descending order
+        void topK(size_t k, std::vector<Entry>& out)
+        {
+            out.clear();
+            for (size_t i = 0; i <= m_mask; i++)
+                if (m_table[i].pc) out.push_back(m_table[i]);
+            k = std::min(k, out.size());
+            std::partial_sort(out.begin(), out.begin() + k, out.end(), moreMispred);
+            out.resize(k);
+        }
+
+    private:
+        Entry* m_table;
+        size_t m_mask;
+        size_t m_used;
+
+        static bool moreMispred(const Entry& a, const Entry& b)
+        {
+            return a.mispred != b.mispred ? a.mispred > b.mispred : a.exec > b.exec;
+        }
+
+        size_t slot(ADDRINT pc)
+        {
+            UINT64 h = (UINT64)pc * 0x9e3779b97f4a7c15ull;
+            return (h >> 32) & m_mask;
+        }
+
+        Entry& find(ADDRINT pc)
+        {
+            size_t i = slot(pc);
+            while (m_table[i].pc != pc)
+            {
+                if (m_table[i].pc == 0)
+                {
+                    if (4 * (m_used + 1) > 3 * (m_mask + 1))
+                    {
+                        grow();
+                        return find(pc);
+                    }
+                    m_table[i].pc = pc;
+                    m_used++;
+                    break;
+                }
+                i = (i + 1) & m_mask;
+            }
+            return m_table[i];
+        }
+
+        void grow()
+        {
+            Entry* old = m_table;
+            size_t old_num = m_mask + 1;
+            m_mask = 2 * old_num - 1;
+            m_table = new Entry[m_mask + 1];
+            memset(m_table, 0, sizeof(Entry) * (m_mask + 1));
+            for (size_t j = 0; j < old_num; j++)
+            {
+                if (!old[j].pc) continue;
+                size_t i = slot(old[j].pc);
+                while (m_table[i].pc) i = (i + 1) & m_mask;
+                m_table[i] = old[j];
+            }
+            delete [] old;
+        }
+};
+
+// Create a predictor from a spec such as "gshare:14:14", NULL if the spec is not understood
+// or a counter width (scnt_width) is outside 1..8
+//      bht:entry_num_log[:scnt_width]
+//      gshare:ghr_width:entry_num_log[:scnt_width]
+//      tournament:bht_entry_num_log:ghr_width:gshare_entry_num_log
+//      tage:tnum:T0_entry_num_log:T1ghr_len:alpha:Tn_entry_num_log[:scnt_width[:rst_period[:tag_width]]]
+//      tagescl: 参数同tage
+//      perceptron:seg_num:entry_num_log:idx_hist_len:alpha
+inline BranchPredictor* makePredictor(const std::string& spec)
+{
+    std::vector<double> a;
+    size_t colon = spec.find(':');
+    std::string name = spec.substr(0, colon);
+    while (colon != std::string::npos)
+    {
+        size_t next = spec.find(':', colon + 1);
+        a.push_back(atof(spec.substr(colon + 1, next - colon - 1).c_str()));
+        colon = next;
+    }
+    #define ARG(i, def) (a.size() > (i) ? a[i] : (def))
+    // 计数器宽度参数必须在1到8之间 (SatCntTable的槽和TAGE的INT8计数器都不超过8位)
+    #define WIDTH_OK(i, def) (ARG(i, def) >= 1 && ARG(i, def) <= 8)
+
+    if ((name == "bht" && !WIDTH_OK(1, 2)) || (name == "gshare" && !WIDTH_OK(2, 2))
+        || ((name == "tage" || name == "tagescl") && !WIDTH_OK(5, 3)))
+        return NULL;
+
+    if (name == "bht")
+        return new BHTPredictor((size_t)ARG(0, 11), (size_t)ARG(1, 2));
+    if (name == "gshare")
+        return new GlobalHistoryPredictor<f_xor>((size_t)ARG(0, 14), (size_t)ARG(1, 14), (size_t)ARG(2, 2));
+    if (name == "tournament")
+        return new TournamentPredictor(new BHTPredictor((size_t)ARG(0, 15)),
+                                       new GlobalHistoryPredictor<f_xor>((size_t)ARG(1, 15), (size_t)ARG(2, 15)));
+    if (name == "tage")
+        return new TAGEPredictor<f_xor, f_xor1>((size_t)ARG(0, 8), (size_t)ARG(1, 13), (size_t)ARG(2, 5),
+                                                (float)ARG(3, 2), (size_t)ARG(4, 10), (size_t)ARG(5, 3),
+                                                (size_t)ARG(6, 256*1024), (size_t)ARG(7, 8));
+    if (name == "tagescl")
+        return new TAGESCLPredictor((size_t)ARG(0, 8), (size_t)ARG(1, 13), (size_t)ARG(2, 5),
+                                    (float)ARG(3, 2), (size_t)ARG(4, 10), (size_t)ARG(5, 3),
+                                    (size_t)ARG(6, 256*1024), (size_t)ARG(7, 8));
+    if (name == "perceptron")
+        return new HashedPerceptronPredictor((size_t)ARG(0, 4), (size_t)ARG(1, 10), (size_t)ARG(2, 8), (float)ARG(3, 2));
+    #undef WIDTH_OK
+    #undef ARG
+    return NULL;
+}
+
+#endif
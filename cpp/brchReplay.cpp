@@ -0,0 +1,140 @@
+/*
+ * Replay a branch trace recorded by brchPredict (-trace) through any predictors, without Pin.
+ *
+ * Build:   g++ -O2 -march=native -o brchReplay brchReplay.cpp
+ * Usage:   ./brchReplay [-targets btb_set_num_log,btb_assoc,ras_depth] trace spec[,spec...] ...
+ *
+ * spec的格式与brchPredict的-predictors相同, 例如 bht:11 gshare:14:14 tage:8:13:5:2:10.
+ * 先把trace中的条件分支解码到内存中, 再依次计时每个预测器, 因此速度一栏只包含预测器本身.
+ * 最后把全部分支再重放一遍, 输出BTB, ITTAGE和RAS的目标预测结果 (-targets给出BTB和RAS的参数).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "brchTrace.h"
+#include "brchPredict.h"
+
+static const char* typeNames[BR_TYPE_NUM] = { "cond", "jump", "jump-ind", "call", "call-ind", "ret" };
+
+static double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: brchReplay [-targets btb_set_num_log,btb_assoc,ras_depth] trace spec[,spec...] ...\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    UINT32 btb_sets_log = 9, btb_assoc = 4, ras_depth = 16;
+    int first = 1;
+    if (argc > 2 && !strcmp(argv[1], "-targets"))
+    {
+        if (!parseTargetSpec(argv[2], btb_sets_log, btb_assoc, ras_depth))
+        {
+            fprintf(stderr, "invalid -targets %s, expected btb_set_num_log(0-24),btb_assoc(1-64),ras_depth(1-65536)\n", argv[2]);
+            return 1;
+        }
+        first = 3;
+    }
+    if (argc < first + 2) usage();
+
+    const char* path = argv[first];
+    BranchTraceReader reader;
+    if (!reader.open(path))
+    {
+        fprintf(stderr, "cannot open trace %s\n", path);
+        return 1;
+    }
+
+    std::vector<std::string> specs;
+    for (int i = first + 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        for (size_t start = 0; start < arg.size(); )
+        {
+            size_t end = arg.find(',', start);
+            if (end == std::string::npos) end = arg.size();
+            if (end > start) specs.push_back(arg.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    // Decode the conditional branches once
+    std::vector<ADDRINT> pcs;
+    std::vector<UINT8> dirs;
+    UINT64 type_num[BR_TYPE_NUM] = { 0 };
+    pcs.reserve(reader.getRecNum());
+    dirs.reserve(reader.getRecNum());
+
+    double start = nowSec();
+    BranchTraceRec rec;
+    while (reader.next(rec))
+    {
+        type_num[rec.type]++;
+        if (rec.type != BR_COND) continue;
+        pcs.push_back(rec.pc);
+        dirs.push_back(rec.taken);
+    }
+    double decode = nowSec() - start;
+    if (reader.isCorrupt())
+    {
+        fprintf(stderr, "corrupt trace %s after %lu branches\n", path, (UINT64)pcs.size());
+        return 1;
+    }
+
+    UINT64 total = 0;
+    for (UINT32 t = 0; t < BR_TYPE_NUM; t++)
+        total += type_num[t];
+    printf("trace: %s, %lu branches, %lu instructions, %.2f bytes/branch, decoded in %.3f s\n", path, total,
+           reader.getInsNum(), total ? (double)reader.getFileSize() / total : 0, decode);
+    for (UINT32 t = 0; t < BR_TYPE_NUM; t++)
+        printf("  %-10s%lu\n", typeNames[t], type_num[t]);
+
+    printf("\n%-40s%-14s%-14s%-12s%-10s%-10s\n", "predictor", "branches", "mispredicts", "accuracy", "MPKI", "Mbr/s");
+    size_t n = pcs.size();
+    for (size_t p = 0; p < specs.size(); p++)
+    {
+        BranchPredictor* bp = makePredictor(specs[p]);
+        if (!bp)
+        {
+            fprintf(stderr, "unknown or invalid predictor spec: %s\n", specs[p].c_str());
+            continue;
+        }
+
+        UINT64 wrong = 0;
+        start = nowSec();
+        for (size_t i = 0; i < n; i++)
+        {
+            bool taken = dirs[i];
+            bool prediction = bp->predict(pcs[i]);
+            bp->update(taken, prediction, pcs[i]);
+            wrong += prediction != taken;
+        }
+        double elapsed = nowSec() - start;
+
+        printf("%-40s%-14lu%-14lu%-12.2f%-10.3f%-10.1f\n", specs[p].c_str(), (UINT64)n, wrong,
+               n ? 100.0 * (n - wrong) / n : 0, reader.getInsNum() ? 1000.0 * wrong / reader.getInsNum() : 0,
+               elapsed > 0 ? n / elapsed * 1e-6 : 0);
+        delete bp;
+    }
+
+    // Target prediction over every branch
+    BranchTargetUnit targets(btb_sets_log, btb_assoc, ras_depth);
+    reader.rewind();
+    while (reader.next(rec))
+        targets.process(rec.pc, rec.target, rec.taken, rec.type, rec.size);
+    fflush(stdout);
+    targets.dump(std::cout, reader.getInsNum());
+    return 0;
+}
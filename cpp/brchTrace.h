@@ -0,0 +1,342 @@
+#ifndef BRCH_TRACE_H
+#define BRCH_TRACE_H
+
+/*
+ * Compressed branch trace: writer and zero-copy reader.
+ *
+ * File layout:
+ *      [FileHeader] [records ...] [FileFooter]
+ *
+ * 一条记录的编码:
+ *      flag    1 byte: bit0-2 分支类型, bit3 跳转, bit4 重复
+ *      重复    flag只有bit4置位, 后面是varint次数n: 上一条记录原样再出现n次
+ *      pc      相对"上一条分支之后的执行位置"的zigzag varint差值
+ *              (上一条跳转时为其目标地址, 否则为其PC)
+ *      [size]  1 byte, 仅当调用指令: 指令长度, 返回地址为pc + size
+ *      [target] 仅当跳转: 相对本条PC的zigzag varint差值
+ * 不跳转的分支不记录目标地址, 读出的target为0.
+ * 循环中只有一条分支时 (以及连续的无条件跳转到同一位置) 会产生大量相同的记录, 由重复编码压缩.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef unsigned char       UINT8;
+typedef unsigned int        UINT32;
+typedef unsigned long int   UINT64;
+
+#define BRCH_TRACE_MAGIC        0x43525442      // "BTRC"
+#define BRCH_TRACE_VERSION      2
+#define BRCH_TRACE_FLUSH        (1u << 20)      // 写缓冲区达到此大小时写出
+
+enum BranchType
+{
+    BR_COND = 0,        // 条件分支 (XED_CATEGORY_COND_BR)
+    BR_JUMP,            // 直接无条件跳转
+    BR_JUMP_IND,        // 间接跳转
+    BR_CALL,            // 直接调用
+    BR_CALL_IND,        // 间接调用
+    BR_RET,             // 返回
+    BR_TYPE_NUM
+};
+
+// One decoded branch
+struct BranchTraceRec
+{
+    UINT64 pc;
+    UINT64 target;          // 仅当taken时有效
+    UINT8 type;
+    UINT8 size;             // 指令长度, 仅调用指令有效
+    bool taken;
+};
+
+namespace btrace
+{
+    struct FileHeader
+    {
+        UINT32 magic;
+        UINT32 version;
+    };
+
+    struct FileFooter
+    {
+        UINT64 rec_num;
+        UINT64 ins_num;         // 记录期间执行的指令数, 用于计算MPKI, 0表示未知
+        UINT32 magic;
+        UINT32 version;
+    };
+
+    enum
+    {
+        TYPE_MASK   = 7,
+        FLAG_TAKEN  = 1 << 3,
+        FLAG_REPEAT = 1 << 4
+    };
+
+    inline bool isCall(UINT32 type) { return type == BR_CALL || type == BR_CALL_IND; }
+
+    inline UINT64 zigzag(UINT64 delta) { return (delta << 1) ^ (UINT64)((long)delta >> 63); }
+    inline UINT64 unzigzag(UINT64 val) { return (val >> 1) ^ (UINT64)(-(long)(val & 1)); }
+
+    inline void putVarint(std::vector<UINT8>& buf, UINT64 val)
+    {
+        while (val >= 0x80)
+        {
+            buf.push_back((UINT8)(val | 0x80));
+            val >>= 7;
+        }
+        buf.push_back((UINT8)val);
+    }
+
+    // Decode a varint from [p, end), return false if it runs past end or over 64 bits
+    inline bool getVarint(const UINT8*& p, const UINT8* end, UINT64& val)
+    {
+        val = 0;
+        for (UINT32 shift = 0; shift < 64 && p < end; shift += 7)
+        {
+            UINT8 b = *p++;
+            val |= (UINT64)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+}
+
+/**************************************
+ * Trace Writer
+**************************************/
+// 非线程安全, 多线程调用者需自行加锁
+class BranchTraceWriter
+{
+public:
+    BranchTraceWriter() : m_fp(NULL) {}
+    ~BranchTraceWriter() { close(); }
+
+    bool open(const char* path)
+    {
+        m_fp = fopen(path, "wb");
+        if (!m_fp) return false;
+
+        btrace::FileHeader hdr = { BRCH_TRACE_MAGIC, BRCH_TRACE_VERSION };
+        fwrite(&hdr, sizeof(hdr), 1, m_fp);
+        m_buf.clear();
+        m_rec_num = 0;
+        m_repeat = 0;
+        m_next_pc = 0;
+        memset(&m_last, 0, sizeof(m_last));
+        m_last.type = BR_TYPE_NUM;          // 第一条记录不会被当作重复
+        return true;
+    }
+
+    void append(const BranchTraceRec& rec)
+    {
+        m_rec_num++;
+        if (rec.pc == m_last.pc && rec.taken == m_last.taken && rec.type == m_last.type
+            && (!rec.taken || rec.target == m_last.target))
+        {
+            m_repeat++;
+            return;
+        }
+        flushRepeat();
+
+        m_buf.push_back(rec.type | (rec.taken ? btrace::FLAG_TAKEN : 0));
+        btrace::putVarint(m_buf, btrace::zigzag(rec.pc - m_next_pc));
+        if (btrace::isCall(rec.type))
+            m_buf.push_back(rec.size);
+        if (rec.taken)
+            btrace::putVarint(m_buf, btrace::zigzag(rec.target - rec.pc));
+
+        m_last = rec;
+        m_next_pc = rec.taken ? rec.target : rec.pc;
+        if (m_buf.size() >= BRCH_TRACE_FLUSH)
+            flushBuf();
+    }
+
+    // Flush the pending records, then write the footer
+    void close(UINT64 ins_num = 0)
+    {
+        if (!m_fp) return;
+        flushRepeat();
+        flushBuf();
+
+        btrace::FileFooter footer;
+        footer.rec_num = m_rec_num;
+        footer.ins_num = ins_num;
+        footer.magic = BRCH_TRACE_MAGIC;
+        footer.version = BRCH_TRACE_VERSION;
+        fwrite(&footer, sizeof(footer), 1, m_fp);
+
+        fclose(m_fp);
+        m_fp = NULL;
+    }
+
+    UINT64 getRecNum() { return m_rec_num; }
+
+private:
+    FILE* m_fp;
+    std::vector<UINT8> m_buf;
+    UINT64 m_rec_num;
+    UINT64 m_repeat;                // 尚未写出的与m_last相同的记录数
+    UINT64 m_next_pc;               // 上一条分支之后的执行位置
+    BranchTraceRec m_last;
+
+    void flushRepeat()
+    {
+        if (m_repeat == 0) return;
+        m_buf.push_back(btrace::FLAG_REPEAT);
+        btrace::putVarint(m_buf, m_repeat);
+        m_repeat = 0;
+    }
+
+    void flushBuf()
+    {
+        if (!m_buf.empty())
+            fwrite(&m_buf[0], 1, m_buf.size(), m_fp);
+        m_buf.clear();
+    }
+};
+
+/**************************************
+ * Trace Reader
+**************************************/
+// 整个文件mmap到内存, 顺序解码. 解码不越过footer; 遇到越界的varint、未知的标志位或类型、
+// 次数为0的重复以及开头的重复时停止, next()返回false且isCorrupt()为真.
+class BranchTraceReader
+{
+public:
+    BranchTraceReader() : m_base(NULL), m_len(0), m_rec_num(0), m_ins_num(0), m_corrupt(false) {}
+    ~BranchTraceReader() { close(); }
+
+    bool open(const char* path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(btrace::FileHeader) + sizeof(btrace::FileFooter))
+        {
+            ::close(fd);
+            return false;
+        }
+        m_len = st.st_size;
+        void* p = mmap(NULL, m_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        m_base = (const UINT8*)p;
+        madvise(p, m_len, MADV_SEQUENTIAL);
+
+        const btrace::FileHeader* hdr = (const btrace::FileHeader*)m_base;
+        btrace::FileFooter footer;
+        memcpy(&footer, m_base + m_len - sizeof(footer), sizeof(footer));
+        if (hdr->magic != BRCH_TRACE_MAGIC || footer.magic != BRCH_TRACE_MAGIC || hdr->version != BRCH_TRACE_VERSION)
+        {
+            close();
+            return false;
+        }
+
+        m_rec_num = footer.rec_num;
+        m_ins_num = footer.ins_num;
+        rewind();
+        return true;
+    }
+
+    void close()
+    {
+        if (m_base) munmap((void*)m_base, m_len);
+        m_base = NULL;
+    }
+
+    UINT64 getRecNum() { return m_rec_num; }
+    UINT64 getInsNum() { return m_ins_num; }
+    size_t getFileSize() { return m_len; }
+
+    // True once next() stopped at a record that could not be decoded
+    bool isCorrupt() { return m_corrupt; }
+
+    void rewind()
+    {
+        m_p = m_base + sizeof(btrace::FileHeader);
+        m_end = m_base + m_len - sizeof(btrace::FileFooter);
+        m_repeat = 0;
+        m_next_pc = 0;
+        memset(&m_last, 0, sizeof(m_last));
+        m_have_last = false;
+        m_corrupt = false;
+    }
+
+    // Decode the next record, return false at the end of the trace or at a corrupt record
+    bool next(BranchTraceRec& rec)
+    {
+        if (m_repeat == 0)
+        {
+            if (m_corrupt || m_p >= m_end) return false;
+            UINT8 flag = *m_p++;
+            UINT64 val;
+            if (flag & btrace::FLAG_REPEAT)
+            {
+                // 重复只跟在一条完整记录之后, 且至少重复一次
+                if (flag != btrace::FLAG_REPEAT || !m_have_last
+                    || !btrace::getVarint(m_p, m_end, val) || val == 0)
+                    return corrupt();
+                m_repeat = val;
+            }
+            else
+            {
+                if ((flag & ~(btrace::TYPE_MASK | btrace::FLAG_TAKEN)) || (flag & btrace::TYPE_MASK) >= BR_TYPE_NUM
+                    || !btrace::getVarint(m_p, m_end, val))
+                    return corrupt();
+                m_last.type = flag & btrace::TYPE_MASK;
+                m_last.taken = flag & btrace::FLAG_TAKEN;
+                m_last.pc = m_next_pc + btrace::unzigzag(val);
+                m_last.size = 0;
+                if (btrace::isCall(m_last.type))
+                {
+                    if (m_p >= m_end) return corrupt();
+                    m_last.size = *m_p++;
+                }
+                m_last.target = 0;
+                if (m_last.taken)
+                {
+                    if (!btrace::getVarint(m_p, m_end, val)) return corrupt();
+                    m_last.target = m_last.pc + btrace::unzigzag(val);
+                }
+                m_next_pc = m_last.taken ? m_last.target : m_last.pc;
+                m_have_last = true;
+                rec = m_last;
+                return true;
+            }
+        }
+        m_repeat--;
+        rec = m_last;
+        return true;
+    }
+
+private:
+    const UINT8* m_base;
+    size_t m_len;
+    UINT64 m_rec_num;
+    UINT64 m_ins_num;
+    bool m_corrupt;
+
+    // 解码状态
+    const UINT8* m_p;
+    const UINT8* m_end;
+    UINT64 m_repeat;                // 上一条记录还要重复的次数
+    UINT64 m_next_pc;
+    BranchTraceRec m_last;
+    bool m_have_last;               // m_last是否已经解码出一条记录
+
+    bool corrupt()
+    {
+        m_corrupt = true;
+        m_repeat = 0;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * Throughput benchmark of the cache models in cacheModel.h (no Pin needed).
+ *
+ * Build:   g++ -O2 -o cacheBench cacheBench.cpp
+ * Usage:   ./cacheBench [accesses_per_run] [baseline.csv]
+ *
+ * 对每个模型、每种几何参数、每种访存模式, 先生成好地址序列再计时,
+ * 输出CSV: model,geometry,pattern,acc_per_sec,ns_per_acc,hit_rate,model_kb
+ * model_kb是从创建模型到跑完期间模型分配的堆内存峰值 (替换全局operator new计数),
+ * 各项互相独立, 与地址序列等进程中其它内存无关.
+ * BeladyOPT的时间包括record()和离线simulate(); Compressed的压缩大小按行地址的哈希
+ * 合成 (约1/4为全零行), 不读真实数据.
+ * 给出baseline.csv (本程序以前的输出) 时, 比较ns_per_acc, 变慢超过10%的项记为回归,
+ * 存在回归时返回1.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <new>
+#include <malloc.h>
+#include "cacheModel.h"
+
+#define REGRESSION_RATIO    1.10
+#define REPEATS             3           // 每项测量取最快的一次, 降低噪声
+#define FA_MAX_BLOCKS       4096        // 全相联模型每次访问O(n), 块数过多时跳过
+
+// Geometry grid: log of the number of sets, associativity, log of the block size
+struct Geometry
+{
+    UINT32 set_num_log;
+    UINT32 asso;
+    UINT32 blksz_log;
+};
+
+static const Geometry geometries[] = {
+    { 6,  4, 6 },
+    { 7,  8, 6 },
+    { 9, 16, 6 },
+};
+
+static const char* patterns[] = { "sequential", "strided", "random", "zipf", "pointer-chase" };
+static const char* models[] = { "FullAsso", "SetAsso", "VIVT", "PIPT", "VIPT", "BitSlice", "XorFold", "SliceHash",
+                                "Skewed", "BeladyOPT", "Compressed", "Sector" };
+
+#define PATTERN_NUM (sizeof(patterns) / sizeof(patterns[0]))
+#define MODEL_NUM   (sizeof(models) / sizeof(models[0]))
+
+// models[]中需要特殊驱动的模型
+#define MODEL_FULL_ASSO     0
+#define MODEL_OPT           9
+#define MODEL_COMPRESSED    10
+
+// LLC切片哈希的地址掩码, 与cacheModel.cpp中-slice_masks的默认值相同
+static const UINT32 slice_masks[] = { 0x2a5b9, 0x1d36e };
+#define SLICE_BITS  (sizeof(slice_masks) / sizeof(slice_masks[0]))
+
+// xorshift64*, deterministic so that runs are comparable
+static UINT64 rng_state = 0x9e3779b97f4a7c15ull;
+static UINT64 nextRand()
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dull;
+}
+
+// Generate an address stream over a working set of ws_lines lines of 64 bytes.
+// 地址的最低位用作读写标志 (cache模型只看4字节对齐的地址)
+static void genPattern(UINT32 pattern, UINT32 ws_lines, std::vector<UINT32>& addrs)
+{
+    const UINT32 base = 0x10000000;
+    size_t n = addrs.size();
+    rng_state = 0x9e3779b97f4a7c15ull + pattern;
+
+    switch (pattern)
+    {
+    case 0:     // sequential 4-byte words
+        for (size_t i = 0; i < n; i++)
+            addrs[i] = base + (UINT32)((i * 4) % ((UINT64)ws_lines * 64));
+        break;
+    case 1:     // page-sized stride, the worst case of bit-slice indexing
+        for (size_t i = 0; i < n; i++)
+            addrs[i] = base + (UINT32)((i * 4096 + (i / ws_lines) * 64) % ((UINT64)ws_lines * 4096));
+        break;
+    case 2:     // uniform random lines
+        for (size_t i = 0; i < n; i++)
+            addrs[i] = base + (UINT32)(nextRand() % ws_lines) * 64;
+        break;
+    case 3:     // Zipf(0.99) over lines, by inverse CDF
+    {
+        std::vector<double> cdf(ws_lines);
+        double sum = 0;
+        for (UINT32 k = 0; k < ws_lines; k++)
+            cdf[k] = (sum += 1.0 / pow(k + 1.0, 0.99));
+        for (size_t i = 0; i < n; i++)
+        {
+            double u = (nextRand() >> 11) * (1.0 / 9007199254740992.0) * sum;
+            UINT32 k = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+            addrs[i] = base + (k < ws_lines ? k : ws_lines - 1) * 64;
+        }
+        break;
+    }
+    default:    // pointer chase along one random cycle through all lines
+    {
+        std::vector<UINT32> perm(ws_lines), next(ws_lines);
+        for (UINT32 k = 0; k < ws_lines; k++)
+            perm[k] = k;
+        for (UINT32 k = ws_lines - 1; k > 0; k--)
+            std::swap(perm[k], perm[nextRand() % (k + 1)]);
+        for (UINT32 k = 0; k < ws_lines; k++)
+            next[perm[k]] = perm[(k + 1) % ws_lines];
+        UINT32 cur = perm[0];
+        for (size_t i = 0; i < n; i++)
+        {
+            addrs[i] = base + cur * 64;
+            cur = next[cur];
+        }
+        break;
+    }
+    }
+
+    // 每4次访问中有1次写
+    for (size_t i = 0; i < n; i++)
+        addrs[i] = (addrs[i] & ~3u) | ((nextRand() & 3) == 0);
+}
+
+// Synthetic compressed size of the line holding addr, for CompressedCache
+static void genLineSizes(const std::vector<UINT32>& addrs, std::vector<UINT8>& sizes)
+{
+    for (size_t i = 0; i < addrs.size(); i++)
+    {
+        UINT32 h = (addrs[i] >> 6) * 0x9e3779b1u;
+        h ^= h >> 15;
+        sizes[i] = (h & 3) == 0 ? 1 : 8 + (h >> 8) % 57;
+    }
+}
+
+static CacheModel* makeModel(UINT32 model, const Geometry& g)
+{
+    switch (model)
+    {
+    case 0: return new FullAssoCache((1u << g.set_num_log) * g.asso, g.blksz_log);
+    case 1: return new SetAssoCache(g.set_num_log, g.asso, g.blksz_log);
+    case 2: return new SetAssoCache_VIVT(g.set_num_log, g.asso, g.blksz_log);
+    case 3: return new SetAssoCache_PIPT(g.set_num_log, g.asso, g.blksz_log);
+    case 4: return new SetAssoCache_VIPT(g.set_num_log, g.asso, g.blksz_log);
+    case 5: return new SetAssoCache_Hashed(g.set_num_log, g.asso, g.blksz_log, new BitSliceIndex(g.set_num_log));
+    case 6: return new SetAssoCache_Hashed(g.set_num_log, g.asso, g.blksz_log, new XorFoldIndex(g.set_num_log));
+    case 7: return new SetAssoCache_Hashed(g.set_num_log, g.asso, g.blksz_log,
+                                           new SliceHashIndex(g.set_num_log, slice_masks, SLICE_BITS));
+    case 8: return new SkewedAssoCache(g.set_num_log, g.asso, g.blksz_log, new SkewedIndex(g.set_num_log));
+    case 9: return new BeladyOPTCache(g.set_num_log, g.asso, g.blksz_log);
+    case 10: return new CompressedCache(g.set_num_log, g.asso, g.blksz_log);
+    default: return new SectorCache(g.set_num_log, g.asso, g.blksz_log, g.blksz_log - 2);
+    }
+}
+
+// Feed the whole stream to a model built by makeModel(model, ...)
+static void runModel(UINT32 model, CacheModel* cache, const std::vector<UINT32>& addrs, const std::vector<UINT8>& sizes)
+{
+    size_t n = addrs.size();
+    if (model == MODEL_OPT)
+    {
+        BeladyOPTCache* opt = (BeladyOPTCache*)cache;
+        for (size_t i = 0; i < n; i++)
+            opt->record(addrs[i] & ~3u, addrs[i] & 1);
+        opt->simulate();
+        return;
+    }
+    if (model == MODEL_COMPRESSED)
+    {
+        CompressedCache* comp = (CompressedCache*)cache;
+        for (size_t i = 0; i < n; i++)
+        {
+            comp->setLineSize(sizes[i]);
+            if (addrs[i] & 1) comp->writeReq(addrs[i] & ~3u);
+            else comp->readReq(addrs[i]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        if (addrs[i] & 1) cache->writeReq(addrs[i] & ~3u);
+        else cache->readReq(addrs[i]);
+    }
+}
+
+static double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Heap accounting: every operator new/delete in the process goes through here
+static size_t heap_live = 0;
+static size_t heap_peak = 0;
+
+void* operator new(size_t bytes)
+{
+    void* p = malloc(bytes ? bytes : 1);
+    if (!p) throw std::bad_alloc();
+    heap_live += malloc_usable_size(p);
+    if (heap_live > heap_peak) heap_peak = heap_live;
+    return p;
+}
+
+void* operator new[](size_t bytes) { return operator new(bytes); }
+
+// noinline: 内联到标准库容器后GCC会把free()误报为与new不匹配
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    if (!p) return;
+    heap_live -= malloc_usable_size(p);
+    free(p);
+}
+
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+// Load "model,geometry,pattern" -> ns_per_acc from a previous run
+static void loadBaseline(const char* path, std::map<std::string, double>& baseline)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot open baseline %s\n", path);
+        return;
+    }
+    char model[64], geo[64], pattern[64];
+    double aps, ns, hit;
+    long kb;
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%63[^,],%63[^,],%63[^,],%lf,%lf,%lf,%ld", model, geo, pattern, &aps, &ns, &hit, &kb) == 7)
+            baseline[std::string(model) + "," + geo + "," + pattern] = ns;
+    }
+    fclose(fp);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t accesses = argc > 1 ? strtoul(argv[1], NULL, 0) : (1u << 20);
+    if (accesses == 0)
+    {
+        fprintf(stderr, "accesses_per_run must be a positive number\n");
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    if (argc > 2) loadBaseline(argv[2], baseline);
+
+    std::vector<UINT32> addrs(accesses);
+    std::vector<UINT8> sizes(accesses);
+    UINT32 regressions = 0;
+
+    printf("model,geometry,pattern,acc_per_sec,ns_per_acc,hit_rate,model_kb\n");
+    for (size_t gi = 0; gi < sizeof(geometries) / sizeof(geometries[0]); gi++)
+    {
+        const Geometry& g = geometries[gi];
+        UINT32 blocks = (1u << g.set_num_log) * g.asso;
+        char geo[64];
+        snprintf(geo, sizeof(geo), "%ux%ux%uB", 1u << g.set_num_log, g.asso, 1u << g.blksz_log);
+
+        for (UINT32 p = 0; p < PATTERN_NUM; p++)
+        {
+            // 工作集取cache容量的两倍, 使各模式都有一定的缺失
+            genPattern(p, blocks * 2, addrs);
+            genLineSizes(addrs, sizes);
+
+            for (UINT32 m = 0; m < MODEL_NUM; m++)
+            {
+                if (m == MODEL_FULL_ASSO && blocks > FA_MAX_BLOCKS) continue;
+
+                double elapsed = 1e30;
+                double hit_rate = 0;
+                size_t model_bytes = 0;
+                for (UINT32 r = 0; r < REPEATS; r++)
+                {
+                    size_t heap = heap_live;
+                    heap_peak = heap_live;
+                    CacheModel* model = makeModel(m, g);
+                    double start = nowSec();
+                    runModel(m, model, addrs, sizes);
+                    double t = nowSec() - start;
+                    if (t < elapsed) elapsed = t;
+                    hit_rate = 100.0 * (accesses - model->getMisses()) / accesses;
+                    model_bytes = heap_peak - heap;
+                    delete model;
+                }
+
+                double ns = elapsed * 1e9 / accesses;
+                printf("%s,%s,%s,%.0f,%.2f,%.2f,%lu\n", models[m], geo, patterns[p],
+                       accesses / elapsed, ns, hit_rate, (UINT64)(model_bytes + 1023) / 1024);
+
+                std::string key = std::string(models[m]) + "," + geo + "," + patterns[p];
+                if (baseline.count(key) && ns > baseline[key] * REGRESSION_RATIO)
+                {
+                    fprintf(stderr, "regression: %s %.2f ns -> %.2f ns\n", key.c_str(), baseline[key], ns);
+                    regressions++;
+                }
+            }
+        }
+    }
+
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Multi-programmed replay of recorded access streams (see memTrace.h) into one
+ * shared cache, to study contention without running the programs together under Pin.
+ *
+ * Build:   g++ -O2 -o cacheMix cacheMix.cpp
+ * Usage:   ./cacheMix [-sets log] [-asso n] [-b log] [-masks m0,m1,...] [-umon log] trace[:rate] ...
+ *
+ * 按加权轮转交织各程序的访问: 每轮程序i获得rate_i的额度, 每次访问消耗1.
+ * rate是相对的访问速率 (trace中没有指令数, 以访问速率近似指令速率), 必须大于0.
+ * 任何一个trace耗尽时停止, 每个程序再单独在同样几何参数的私有cache上重放它在混合中
+ * 消耗的那部分访问, 两者缺失率之比即竞争导致的缺失率放大.
+ * 共享cache中每个程序是一个owner, 可以用-masks给出各自的路掩码, 并输出UCP建议的划分.
+ *
+ * 模型的地址是32位的: 每个程序的地址只保留低28位, 最高4位换成程序号, 因此每个程序
+ * 只有256MB的地址空间, 相差256MB整数倍的地址 (如堆和栈) 会在同一程序内互相混叠.
+ * 单个程序的访问足迹超过256MB时结果不可靠.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "cacheModel.h"
+#include "memTrace.h"
+
+#define MAX_PROGRAMS    16      // 程序号放在地址的最高4位, 避免不同程序的相同地址互相命中
+#define PROG_SHIFT      28      // 每个程序256MB地址空间
+
+struct Program
+{
+    std::string path;
+    double rate;
+    double credit;
+    MemTraceReader reader;
+    UINT64 consumed;            // 混合运行中消耗的访问数
+};
+
+// 丢弃第28位以上的地址位再放入程序号, 不同程序的地址不会重叠
+static UINT32 tagAddr(UINT64 addr, UINT32 prog)
+{
+    return ((UINT32)addr & ((1u << PROG_SHIFT) - 1) & ~3u) | (prog << PROG_SHIFT);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: cacheMix [-sets log] [-asso n] [-b log] [-masks m0,m1,...] [-umon log] trace[:rate] ...\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    UINT32 set_num_log = 10, asso = 16, blksz_log = 6, umon_log = 5;
+    std::vector<UINT64> masks;
+    std::vector<Program*> progs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-sets") && i + 1 < argc) set_num_log = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-asso") && i + 1 < argc) asso = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc) blksz_log = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-umon") && i + 1 < argc) umon_log = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-masks") && i + 1 < argc)
+        {
+            for (char* p = argv[++i]; *p; )
+            {
+                char* end;
+                masks.push_back(strtoull(p, &end, 16));
+                if (end == p) usage();
+                p = (*end == ',') ? end + 1 : end;
+            }
+        }
+        else if (argv[i][0] == '-') usage();
+        else
+        {
+            Program* prog = new Program;
+            std::string arg = argv[i];
+            size_t colon = arg.rfind(':');
+            prog->path = arg.substr(0, colon);
+            prog->rate = 1.0;
+            if (colon != std::string::npos)
+            {
+                // rate <= 0时该程序永远得不到额度, 混合运行不会结束
+                char* end;
+                prog->rate = strtod(arg.c_str() + colon + 1, &end);
+                if (end == arg.c_str() + colon + 1 || *end || !(prog->rate > 0 && prog->rate < 1e9))
+                {
+                    fprintf(stderr, "invalid rate in %s, it must be a positive number\n", argv[i]);
+                    return 1;
+                }
+            }
+            prog->credit = 0;
+            prog->consumed = 0;
+            if (!prog->reader.open(prog->path.c_str()))
+            {
+                fprintf(stderr, "cannot open trace %s\n", prog->path.c_str());
+                return 1;
+            }
+            progs.push_back(prog);
+        }
+    }
+    if (progs.empty() || progs.size() > MAX_PROGRAMS) usage();
+
+    // Shared run: weighted round-robin until one trace runs out
+    SetAssoCache_Hashed shared(set_num_log, asso, blksz_log, new BitSliceIndex(set_num_log));
+    shared.setOwnerNum(progs.size());
+    for (size_t i = 0; i < masks.size(); i++)
+        shared.setWayMask(i, masks[i]);
+    shared.enableUMON(umon_log);
+
+    std::vector<UINT64> shared_misses(progs.size(), 0);
+    bool running = true;
+    while (running)
+    {
+        for (UINT32 p = 0; p < progs.size() && running; p++)
+        {
+            Program* prog = progs[p];
+            for (prog->credit += prog->rate; prog->credit >= 1; prog->credit -= 1)
+            {
+                MemAccess rec;
+                if (!prog->reader.next(rec))
+                {
+                    if (prog->reader.isCorrupt())
+                    {
+                        fprintf(stderr, "corrupt trace %s at access %lu\n", prog->path.c_str(), prog->consumed);
+                        exit(1);
+                    }
+                    running = false;
+                    break;
+                }
+                UINT64 before = shared.getMisses();
+                if (rec.is_write) shared.writeReq(tagAddr(rec.addr, p), p);
+                else shared.readReq(tagAddr(rec.addr, p), p);
+                shared_misses[p] += shared.getMisses() - before;
+                prog->consumed++;
+            }
+        }
+    }
+
+    // Alone runs over the same prefix of every trace
+    printf("%-4s%-32s%-8s%-14s%-14s%-14s%-10s\n", "id", "trace", "rate", "accesses", "alone miss", "shared miss", "ratio");
+    for (UINT32 p = 0; p < progs.size(); p++)
+    {
+        Program* prog = progs[p];
+        SetAssoCache_Hashed alone(set_num_log, asso, blksz_log, new BitSliceIndex(set_num_log));
+        prog->reader.seek(0);
+        MemAccess rec;
+        for (UINT64 n = 0; n < prog->consumed && prog->reader.next(rec); n++)
+        {
+            if (rec.is_write) alone.writeReq(tagAddr(rec.addr, p));
+            else alone.readReq(tagAddr(rec.addr, p));
+        }
+
+        double alone_rate = prog->consumed ? 100.0 * alone.getMisses() / prog->consumed : 0;
+        double shared_rate = prog->consumed ? 100.0 * shared_misses[p] / prog->consumed : 0;
+        printf("%-4u%-32s%-8.2f%-14lu%-14.2f%-14.2f%-10.2f\n", p, prog->path.c_str(), prog->rate, prog->consumed,
+               alone_rate, shared_rate, alone_rate > 0 ? shared_rate / alone_rate : 0);
+    }
+
+    printf("\nShared cache (%u sets, %u ways, %u-byte blocks):\n", 1u << set_num_log, asso, 1u << blksz_log);
+    shared.dumpResults();
+    shared.dumpPartition();
+
+    for (UINT32 p = 0; p < progs.size(); p++)
+        delete progs[p];
+    return 0;
+}
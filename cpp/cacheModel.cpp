@@ -1,583 +1,529 @@
 #include <cstdio>
-#include <cmath>
+#include <cstdlib>
 #include <ctime>
+#include <string>
+#include <vector>
 #include "pin.H"
+#include "cacheModel.h"
+#include "memTrace.h"
+#include "cacheStats.h"
 
-typedef unsigned int        UINT32;
-typedef unsigned long int   UINT64;
+#define COMP_MAX_BLKSZ_LOG  8       // 数据感知模式的最大行大小 (256字节)
 
+CacheModel* my_fa_cache;
+CacheModel* my_sa_cache;
+CacheModel* my_sa_cache_vivt;
+CacheModel* my_sa_cache_pipt;
+CacheModel* my_sa_cache_vipt;
 
-#define PAGE_SIZE_LOG       12
-#define PHY_MEM_SIZE_LOG    30
+// 与my_sa_cache几何参数相同、只是组号映射不同的模型, 用于量化哈希消除的冲突缺失
+CacheModel* my_sa_cache_slice;
+CacheModel* my_sa_cache_xor;
+CacheModel* my_sa_cache_skew;
+CacheModel* my_sa_cache_llc;
 
-//get page
-#define get_vir_page_no(virtual_addr)   (virtual_addr >> PAGE_SIZE_LOG)
+// 按线程划分路的共享LLC, 每个线程是一个owner.
+// 同步模式下各线程并发访问, owner对应的UMON会修改每组的栈, 因此访问在my_llc_lock内进行
+SetAssoCache_Hashed* my_llc_part;
+PIN_LOCK my_llc_lock;
 
-//get offset
-#define get_page_offset(addr)           (addr & ((1u << PAGE_SIZE_LOG) - 1))
+// 与my_sa_cache_slice几何参数相同的Belady OPT, 记录访存流并在Fini中离线求解
+BeladyOPTCache* my_opt = NULL;
 
-// Obtain physical page number according to a given virtual page number
-UINT32 get_phy_page_no(UINT32 virtual_page_no)
-{
-    UINT32 vpn = virtual_page_no;
-    vpn = (~vpn ^ (vpn << 16)) + (vpn & (vpn << 16)) + (~vpn | (vpn << 2));
+// OPT的记录满后停止记录, 同时冻结LRU一侧 (my_sa_cache_slice) 的统计, 使两者比较同一段前缀
+BeladyOPTCache* my_opt_rec = NULL;          // 仍在记录时等于my_opt, 满后为NULL
+UINT64 my_opt_lru_misses, my_opt_rd_repeats, my_opt_wr_repeats;
+PIN_LOCK my_opt_lock;                       // 同步模式下各线程并发记录, 记录和冻结都在锁内
 
-    UINT32 mask = (UINT32)(~0) << (32 - PHY_MEM_SIZE_LOG);
-    mask = mask >> (32 - PHY_MEM_SIZE_LOG + PAGE_SIZE_LOG);
-    mask = mask << PAGE_SIZE_LOG;
+// 数据感知模式: 按访问时的行内容压缩的cache, 以及相同几何参数的未压缩基准
+CompressedCache* my_comp_bdi = NULL;
+CompressedCache* my_comp_fpc = NULL;
+CacheModel* my_comp_base = NULL;
+UINT32 my_comp_blksz_log;
 
-    return vpn & mask;
-}
+// 可选的扇区cache, 以及容量固定、行大小不同的一组cache
+SectorCache* my_sector = NULL;
+LineSizeSweep* my_sweep = NULL;
 
-// Transform a virtual address into a physical address
-UINT32 get_phy_addr(UINT32 virtual_addr)
-{
-    return (get_phy_page_no(get_vir_page_no(virtual_addr)) << PAGE_SIZE_LOG) + get_page_offset(virtual_addr);
-}
-
-/**************************************
- * Cache Model Base Class
-**************************************/
-class CacheModel
-{
-public:
-    // Constructor
-    CacheModel(UINT32 block_num, UINT32 log_block_size)
-        : m_block_num(block_num), m_blksz_log(log_block_size),
-          m_rd_reqs(0), m_wr_reqs(0), m_rd_hits(0), m_wr_hits(0)
-    {
-        m_valids = new bool[m_block_num];
-        m_tags = new UINT32[m_block_num];
-        m_replace_q = new UINT32[m_block_num];
+// 所有数据cache模型, 用于统一处理 (如同行过滤的命中补记)
+std::vector<CacheModel*> my_data_models;
+std::vector<std::string> my_data_names;
 
-        for (UINT i = 0; i < m_block_num; i++)
-        {
-            m_valids[i] = false;
-            m_replace_q[i] = i;
-        }
-    }
+// 指令cache, 以基本块为粒度取指
+CacheModel* my_icache;
 
-    // Destructor
-    virtual ~CacheModel()
-    {
-        delete[] m_valids;
-        delete[] m_tags;
-        delete[] m_replace_q;
-    }
+// PIPT cache的缺失送往主存模型
+DRAMModel* my_dram;
 
-    // Update the cache state whenever data is read
-    void readReq(UINT32 mem_addr)
-    {
-        m_rd_reqs++;
-        if (access(mem_addr)) m_rd_hits++;
-    }
+UINT64 sumRepeats(bool is_write);
 
-    // Update the cache state whenever data is written
-    void writeReq(UINT32 mem_addr)
-    {
-        m_wr_reqs++;
-        if (access(mem_addr)) m_wr_hits++;
-    }
-
-    UINT32 getRdReq() { return m_rd_reqs; }
-    UINT32 getWrReq() { return m_wr_reqs; }
+// Called before an access once the OPT stream is full: the LRU models have seen exactly the recorded prefix
+void freezeOpt()
+{
+    my_opt_lru_misses = my_sa_cache_slice->getMisses();
+    my_opt_rd_repeats = sumRepeats(false);
+    my_opt_wr_repeats = sumRepeats(true);
+    my_opt_rec = NULL;
+    fprintf(stderr, "warning: Belady OPT recorded its limit of %lu accesses, "
+            "OPT and its gap to LRU only cover this prefix\n", my_opt->getRecorded());
+}
 
-    void dumpResults()
+// Record an access for OPT before the LRU models see it, freezing them once the stream is full
+void recordOpt(UINT32 mem_addr, bool is_write, THREADID tid)
+{
+    PIN_GetLock(&my_opt_lock, tid + 1);
+    if (my_opt_rec)
     {
-        float rdHitRate = 100 * (float)m_rd_hits/m_rd_reqs;
-        float wrHitRate = 100 * (float)m_wr_hits/m_wr_reqs;
-        printf("\tread req: %lu,\thit: %lu,\thit rate: %.2f%%\n", m_rd_reqs, m_rd_hits, rdHitRate);
-        printf("\twrite req: %lu,\thit: %lu,\thit rate: %.2f%%\n", m_wr_reqs, m_wr_hits, wrHitRate);
+        if (my_opt_rec->isFull()) freezeOpt();
+        else my_opt_rec->record(mem_addr, is_write);
     }
+    PIN_ReleaseLock(&my_opt_lock);
+}
 
-protected:
-    UINT32 m_block_num;     // The number of cache blocks
-    UINT32 m_blksz_log;     // 块大小的对数
+// Cache reading analysis routine
+void readCache(UINT32 mem_addr, THREADID tid)
+{
+    mem_addr = (mem_addr >> 2) << 2;
+    if (my_opt) recordOpt(mem_addr, false, tid);
 
-    bool* m_valids;
-    UINT32* m_tags;
-    UINT32* m_replace_q;    // Cache块替换的候选队列
+    my_fa_cache->readReq(mem_addr);
+    my_sa_cache->readReq(mem_addr);
 
-    UINT64 m_rd_reqs;       // The number of read-requests
-    UINT64 m_wr_reqs;       // The number of write-requests
-    UINT64 m_rd_hits;       // The number of hit read-requests
-    UINT64 m_wr_hits;       // The number of hit write-requests
+    my_sa_cache_vivt->readReq(mem_addr);
+    my_sa_cache_pipt->readReq(mem_addr);
+    my_sa_cache_vipt->readReq(mem_addr);
 
-    // Look up the cache to decide whether the access is hit or missed
-    virtual bool lookup(UINT32 mem_addr, UINT32& blk_id) = 0;
+    my_sa_cache_slice->readReq(mem_addr);
+    my_sa_cache_xor->readReq(mem_addr);
+    my_sa_cache_skew->readReq(mem_addr);
+    my_sa_cache_llc->readReq(mem_addr);
 
-    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
-    virtual bool access(UINT32 mem_addr) = 0;
+    PIN_GetLock(&my_llc_lock, tid + 1);
+    my_llc_part->readReq(mem_addr, tid);
+    PIN_ReleaseLock(&my_llc_lock);
 
-    // Update m_replace_q
-    virtual void updateReplaceQ(UINT32 blk_id) = 0;
-};
+    if (my_sector) my_sector->readReq(mem_addr);
+    if (my_sweep) my_sweep->readReq(mem_addr);
+}
 
-/**************************************
- * Fully Associative Cache Class
-**************************************/
-class FullAssoCache : public CacheModel
+// Cache writing analysis routine
+void writeCache(UINT32 mem_addr, THREADID tid)
 {
-public:
-    // Constructor
-    FullAssoCache(UINT32 block_num, UINT32 log_block_size)
-        : CacheModel(block_num, log_block_size) {
-        }
+    mem_addr = (mem_addr >> 2) << 2;
+    if (my_opt) recordOpt(mem_addr, true, tid);
 
-    // Destructor
-    ~FullAssoCache() {}
-
-private:
-    UINT32 getTag(UINT32 addr) { 
-        return (addr >> m_blksz_log);
-        /* TODO */ }
-
-    
-
-    // Look up the cache to decide whether the access is hit or missed
-    bool lookup(UINT32 mem_addr, UINT32& blk_id)
-    {
-        UINT32 tag = getTag(mem_addr);
-        // TODO
-        for(UINT32 i =0; i < m_block_num; i++){
-            if(m_tags[i] == tag){
-                blk_id = i;
-                if(m_valids[i]){
-                    return true;
-                }
-                else{
-                    return false;
-                }
-            }
-        }
+    my_fa_cache->writeReq(mem_addr);
+    my_sa_cache->writeReq(mem_addr);
 
-        return false;
-    }
+    my_sa_cache_vivt->writeReq(mem_addr);
+    my_sa_cache_pipt->writeReq(mem_addr);
+    my_sa_cache_vipt->writeReq(mem_addr);
 
-    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
-    bool access(UINT32 mem_addr)
-    {
-        UINT32 blk_id;
-        if (lookup(mem_addr, blk_id))
-        {
-            updateReplaceQ(blk_id);     // Update m_replace_q
-            return true;
-        }
+    my_sa_cache_slice->writeReq(mem_addr);
+    my_sa_cache_xor->writeReq(mem_addr);
+    my_sa_cache_skew->writeReq(mem_addr);
+    my_sa_cache_llc->writeReq(mem_addr);
 
-        // Get the to-be-replaced block id using m_replace_q
-        UINT32 bid_2be_replaced = m_replace_q[0];
-        // TODO
+    PIN_GetLock(&my_llc_lock, tid + 1);
+    my_llc_part->writeReq(mem_addr, tid);
+    PIN_ReleaseLock(&my_llc_lock);
 
-        // Replace the cache block
-        // TODO
-        m_tags[bid_2be_replaced] = getTag(mem_addr);
-        m_valids[bid_2be_replaced] = true;
-        updateReplaceQ(bid_2be_replaced);
+    if (my_sector) my_sector->writeReq(mem_addr);
+    if (my_sweep) my_sweep->writeReq(mem_addr);
+}
 
-        return false;
+// Data-aware analysis routine: read the line with PIN_SafeCopy and feed its compressed sizes
+// 在访问之前读取, 因此写操作看到的是写入前的内容
+void compressAccess(ADDRINT mem_addr, BOOL is_write)
+{
+    UINT8 line[1 << COMP_MAX_BLKSZ_LOG];
+    UINT32 line_size = 1u << my_comp_blksz_log;
+    ADDRINT line_addr = mem_addr & ~(ADDRINT)(line_size - 1);
+    size_t copied = PIN_SafeCopy(line, (VOID*)line_addr, line_size);
+    if (copied < line_size) memset(line + copied, 0, line_size - copied);
+
+    UINT32 addr = (UINT32)mem_addr & ~3u;
+    my_comp_bdi->setLineSize(compress::bdiSize(line, line_size));
+    my_comp_fpc->setLineSize(compress::fpcSize(line, line_size));
+    if (is_write)
+    {
+        my_comp_bdi->writeReq(addr);
+        my_comp_fpc->writeReq(addr);
+        my_comp_base->writeReq(addr);
     }
-
-    // Update m_replace_q
-    void updateReplaceQ(UINT32 blk_id)
+    else
     {
-        // TODO
-        for(UINT32 i =0; i < m_block_num; i++){
-            if(m_replace_q[i] == blk_id){
-                for(UINT32 j = i + 1; j < m_block_num; j++){
-                    m_replace_q[j-1] = m_replace_q[j];
-                }
-                m_replace_q[m_block_num-1] = blk_id;
-                break;
-            }
-        }
+        my_comp_bdi->readReq(addr);
+        my_comp_fpc->readReq(addr);
+        my_comp_base->readReq(addr);
     }
-};
+}
+
+UINT32 my_icache_blksz_log;
+
+// Instruction fetch analysis routine: fetch line_num consecutive lines starting at line_addr
+void fetchBlock(UINT32 line_addr, UINT32 line_num)
+{
+    for (UINT32 i = 0; i < line_num; i++)
+        my_icache->readReq(line_addr + (i << my_icache_blksz_log));
+}
 
 /**************************************
- * Set-Associative Cache Class
+ * Asynchronous Simulation
 **************************************/
-class SetAssoCache : public CacheModel
+// 应用线程只把访问打包写入自己的单生产者/单消费者环形队列, 由一个Pin内部线程
+// 轮流取出各队列的记录并调用readCache/writeCache; 队列满时生产者让出CPU等待.
+// 不同线程的访问交织顺序与同步模式不同, 多线程程序在共享模型上的结果是近似的.
+// 取指 (L1I)、数据感知的压缩模型和记录模式仍在应用线程中同步执行.
+// 进程退出时模拟线程清空队列后退出; 此后仍在运行的应用线程 (以及Fini) 持my_async_lock
+// 先模拟自己队列中剩余的记录, 再同步模拟新的访问, 既不丢失记录, 也不会在满队列上等待.
+#define ASYNC_MAX_THREADS   256
+#define ASYNC_RING_LOG      14
+#define ASYNC_BATCH         1024        // 消费者每次从一个队列最多取出的记录数
+
+// 填充按64字节的cache行计算, 因此结构体按64字节对齐, 并用posix_memalign分配
+struct alignas(64) AccessRing
 {
-public:
-    // Constructor
-    SetAssoCache(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
-        this->set_block_size = set_block_size;
-        this->set_num_log = set_num_log;
-    }
-
-    // Destructor
-    ~SetAssoCache() {}
+    // 生产者独占的cache行
+    UINT64 tail;
+    UINT64 head_cache;                  // 生产者看到的head, 只在队列看似已满时重新读取
+    UINT64 stalls;                      // 队列满而等待的次数
+    UINT8 pad0[40];
+    // 消费者写的cache行
+    UINT64 head;
+    UINT8 pad1[56];
+    UINT32 buf[1 << ASYNC_RING_LOG];    // 4字节对齐的地址 | 是否写
+};
 
-private:
+AccessRing* my_rings[ASYNC_MAX_THREADS];
+bool my_async_on = false;
+bool my_async_stop = false;
+bool my_async_done = false;             // 模拟线程已经退出
+UINT64 my_async_dropped = 0;            // 线程号超出ASYNC_MAX_THREADS或没有队列而丢弃的访问
+UINT64 my_async_late = 0;               // 模拟线程退出后同步模拟的访问
+PIN_LOCK my_async_lock;                 // 模拟线程退出后, 串行化队列的消费和模型
+PIN_THREAD_UID my_async_uid;
+
+// Simulate at most max records of the ring of tid, return the number of records simulated
+UINT32 drainRing(THREADID tid, UINT64 max)
+{
+    AccessRing* ring = __atomic_load_n(&my_rings[tid], __ATOMIC_ACQUIRE);
+    if (!ring) return 0;
+
+    UINT64 head = ring->head;
+    UINT64 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (tail - head > max) tail = head + max;
+    UINT32 n = tail - head;
+    for (; head != tail; head++)
+    {
+        UINT32 rec = ring->buf[head & ((1u << ASYNC_RING_LOG) - 1)];
+        if (rec & 1) writeCache(rec & ~3u, tid);
+        else readCache(rec, tid);
+    }
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    return n;
+}
 
-    // 
-    UINT32 set_num_log;
-    UINT32 set_block_size;
+// After the simulator thread has exited: simulate what is left in our ring, then this access
+void simulateLate(THREADID tid, UINT32 rec)
+{
+    PIN_GetLock(&my_async_lock, tid + 1);
+    drainRing(tid, ~0ul);
+    if (rec & 1) writeCache(rec & ~3u, tid);
+    else readCache(rec, tid);
+    my_async_late++;
+    PIN_ReleaseLock(&my_async_lock);
+}
 
-    //tag
-    UINT32 get_tag(UINT32 mem_addr){
-        return mem_addr >> (set_num_log + PAGE_SIZE_LOG);
+inline void enqueue(THREADID tid, UINT32 rec)
+{
+    if (tid >= ASYNC_MAX_THREADS || !my_rings[tid])
+    {
+        __atomic_add_fetch(&my_async_dropped, 1, __ATOMIC_RELAXED);
+        return;
     }
-
-    UINT32 get_set_num(UINT32 mem_addr){
-        return ((mem_addr << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
+    if (__atomic_load_n(&my_async_done, __ATOMIC_ACQUIRE))
+    {
+        simulateLate(tid, rec);
+        return;
     }
 
-    // Look up the cache to decide whether the access is hit or missed
-    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    AccessRing* ring = my_rings[tid];
+    UINT64 tail = ring->tail;
+    if (tail - ring->head_cache == (1u << ASYNC_RING_LOG))
     {
-        // TODO
-        UINT32 tag =  get_tag(mem_addr);
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 Start  = set_num * set_block_size;
-        for(UINT32 i = 0; i < set_block_size; i++)
+        ring->stalls++;
+        while (tail - (ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) == (1u << ASYNC_RING_LOG))
         {
-            blk_id = Start + i;
-            if(m_tags[Start + i] == tag){
-                
-                if(m_valids[Start + i] == true){
-                    return true;
-                }
-                else{
-                    return false;
-                }
+            // 模拟线程已退出, 不会再有人清空队列
+            if (__atomic_load_n(&my_async_done, __ATOMIC_ACQUIRE))
+            {
+                simulateLate(tid, rec);
+                return;
             }
+            PIN_Yield();
         }
-        return false;
-    }
-
-    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
-    bool access(UINT32 mem_addr)
-    {
-        // TODO
-        UINT32 blk_id;
-        if(lookup(mem_addr, blk_id)){
-            updateReplaceQ(blk_id);
-            return true;
-        }
-
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
-        m_tags[bid_2be_replaced] = get_tag(mem_addr);
-        m_valids[bid_2be_replaced] = true;
-        updateReplaceQ(bid_2be_replaced);
-        return false;
-    }
-
-    // Update m_replace_q
-    void updateReplaceQ(UINT32 blk_id)
-    {
-        // TODO
-        UINT32 set_num = blk_id / set_block_size;
-        UINT32 Start = set_num * set_block_size;
-        for(UINT32 i =0 ;i < set_block_size; i++){
-            if(m_replace_q[Start + i] == blk_id){
-                for(UINT32 j = i + 1; j < set_block_size; j++){
-                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
-                }
-                m_replace_q[Start + set_block_size - 1] = blk_id;
-                break;
-            }
-        } 
     }
-};
+    ring->buf[tail & ((1u << ASYNC_RING_LOG) - 1)] = rec;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
 
-/**************************************
- * Set-Associative Cache Class (VIVT)
-**************************************/
-class SetAssoCache_VIVT : public CacheModel
+// Producer analysis routines used instead of readCache/writeCache in the asynchronous mode
+void readEnqueue(ADDRINT mem_addr, THREADID tid)
 {
-public:
-    // Constructor
-    SetAssoCache_VIVT(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
-        this->set_block_size = set_block_size;
-        this->set_num_log = set_num_log;
-    }
-
-    // Destructor
-    ~SetAssoCache_VIVT() {}
-
-private:
-
-    // Add your members
-    UINT32 set_num_log;
-    UINT32 set_block_size;
-    // Look up the cache to decide whether the access is hit or missed
-
-     //tag
-    UINT32 get_tag(UINT32 mem_addr){
-        return mem_addr >> (set_num_log + PAGE_SIZE_LOG);
-    }
+    enqueue(tid, (UINT32)mem_addr & ~3u);
+}
 
-    UINT32 get_set_num(UINT32 mem_addr){
-        return ((mem_addr << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
-    }
+void writeEnqueue(ADDRINT mem_addr, THREADID tid)
+{
+    enqueue(tid, ((UINT32)mem_addr & ~3u) | 1);
+}
 
+// Simulate at most ASYNC_BATCH records of every ring, return the number of records simulated
+UINT32 drainRings()
+{
+    UINT32 n = 0;
+    for (THREADID tid = 0; tid < ASYNC_MAX_THREADS; tid++)
+        n += drainRing(tid, ASYNC_BATCH);
+    return n;
+}
 
-   // Look up the cache to decide whether the access is hit or missed
-    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+// The internal simulator thread: consume until the application exits, then drain what is left
+// 退出后由生产者自己消费, 因此设置my_async_done之前必须停止读取队列
+VOID simulatorThread(VOID* arg)
+{
+    while (!__atomic_load_n(&my_async_stop, __ATOMIC_ACQUIRE))
     {
-        // TODO
-        UINT32 tag =  get_tag(mem_addr);
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 Start  = set_num * set_block_size;
-        for(UINT32 i = 0; i < set_block_size; i++){
-            blk_id = Start + i;
-            if(m_tags[Start + i] == tag){
-                
-                if(m_valids[Start + i] == true){
-                    return true;
-                }
-                else{
-                    return false;
-                }
-            }
-        }
-        return false;
+        if (drainRings() == 0) PIN_Yield();
     }
+    while (drainRings())
+        ;
+    __atomic_store_n(&my_async_done, true, __ATOMIC_RELEASE);
+}
 
-    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
-    bool access(UINT32 mem_addr)
+VOID AsyncThreadStart(THREADID tid, CONTEXT* ctxt, INT32 flags, VOID* v)
+{
+    if (tid >= ASYNC_MAX_THREADS || my_rings[tid]) return;
+    void* mem;
+    if (posix_memalign(&mem, alignof(AccessRing), sizeof(AccessRing)) != 0)
     {
-        // TODO
-        UINT32 blk_id;
-        if(lookup(mem_addr, blk_id)){
-            updateReplaceQ(blk_id);
-            return true;
-        }
-
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
-        m_tags[bid_2be_replaced] = get_tag(mem_addr);
-        m_valids[bid_2be_replaced] = true;
-        updateReplaceQ(bid_2be_replaced);
-        return false;
-    }
-
-    // Update m_replace_q
-    void updateReplaceQ(UINT32 blk_id)
-    {
-        // TODO
-        UINT32 set_num = blk_id / set_block_size;
-        UINT32 Start = set_num * set_block_size;
-        for(UINT32 i =0 ;i < set_block_size; i++){
-            if(m_replace_q[Start + i] == blk_id){
-                for(UINT32 j = i + 1; j < set_block_size; j++){
-                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
-                }
-                m_replace_q[Start + set_block_size - 1] = blk_id;
-                break;
-            }
-        } 
+        fprintf(stderr, "cannot allocate the access queue of thread %u, its accesses are dropped\n", tid);
+        return;
     }
-};
+    AccessRing* ring = (AccessRing*)mem;
+    ring->tail = ring->head_cache = ring->stalls = ring->head = 0;
+    __atomic_store_n(&my_rings[tid], ring, __ATOMIC_RELEASE);
+}
+
+// Called before Fini while the application threads are stopped: let the simulator finish
+VOID PrepareForFini(VOID* v)
+{
+    __atomic_store_n(&my_async_stop, true, __ATOMIC_RELEASE);
+    PIN_WaitForThreadTermination(my_async_uid, PIN_INFINITE_TIMEOUT, NULL);
+}
 
 /**************************************
- * Set-Associative Cache Class (PIPT)
+ * Live Statistics Page
 **************************************/
-class SetAssoCache_PIPT : public CacheModel
-{
-public:
-    // Constructor
-    SetAssoCache_PIPT(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
-        this->set_block_size = set_block_size;
-        this->set_num_log = set_num_log;
-    }
-
-    // Destructor
-    ~SetAssoCache_PIPT() {}
-
-private:
-
-    // Add your members
-    UINT32 set_num_log;
-    UINT32 set_block_size;
-
-     //tag
-    //tag
-    UINT32 get_tag(UINT32 mem_addr){
-        return get_phy_addr(mem_addr) >> (set_num_log + PAGE_SIZE_LOG);
-    }
-
-    UINT32 get_set_num(UINT32 mem_addr){
-        return ((get_phy_addr(mem_addr) << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
-    }
-    // Look up the cache to decide whether the access is hit or missed
-    bool lookup(UINT32 mem_addr, UINT32& blk_id)
-    {
-        // TODO
-        UINT32 tag =  get_tag(mem_addr);
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 Start  = set_num * set_block_size;
-        for(UINT32 i = 0; i < set_block_size; i++){
-            blk_id = Start + i;
-            if(m_tags[Start + i] == tag){
-                
-                if(m_valids[Start + i] == true){
-                    return true;
-                }
-                else{
-                    return false;
-                }
-            }
-        }
-        return false;
-    }
+// 一个内部线程每隔stats_period毫秒把各数据模型的计数发布到共享内存 (见cacheStats.h),
+// 可以用cacheStat在运行中查看. 计数由分析函数并发更新, 读取不加锁, 数值是近似的快照.
+StatsWriter my_stats;
+bool my_stats_on = false;
+bool my_stats_stop = false;
+UINT32 my_stats_period;
+UINT64 my_start_ms;
+PIN_THREAD_UID my_stats_uid;
+
+UINT64 nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
-    bool access(UINT32 mem_addr)
+// Copy the counters into the page; rd_extra/wr_extra are repeats not credited to the models yet
+void publishStats(UINT64 rd_extra, UINT64 wr_extra, bool finished)
+{
+    StatsPage* page = my_stats.beginUpdate();
+    page->elapsed_ms = nowMs() - my_start_ms;
+    page->finished = finished;
+    page->model_num = std::min(my_data_models.size(), (size_t)CACHE_STATS_MAX_MODELS);
+    for (UINT32 i = 0; i < page->model_num; i++)
     {
-        // TODO
-        UINT32 blk_id;
-        if(lookup(mem_addr, blk_id)){
-            updateReplaceQ(blk_id);
-            return true;
-        }
+        ModelStats& m = page->models[i];
+        strncpy(m.name, my_data_names[i].c_str(), sizeof(m.name) - 1);
+        m.rd_reqs = my_data_models[i]->getRdReq() + rd_extra;
+        m.rd_hits = my_data_models[i]->getRdHits() + rd_extra;
+        m.wr_reqs = my_data_models[i]->getWrReq() + wr_extra;
+        m.wr_hits = my_data_models[i]->getWrHits() + wr_extra;
+    }
+    page->accesses = page->model_num ? page->models[0].rd_reqs + page->models[0].wr_reqs : 0;
+    my_stats.endUpdate();
+}
 
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
-        m_tags[bid_2be_replaced] = get_tag(mem_addr);
-        m_valids[bid_2be_replaced] = true;
-        updateReplaceQ(bid_2be_replaced);
-        return false;
-    }
-
-    // Update m_replace_q
-    void updateReplaceQ(UINT32 blk_id)
-    {
-        // TODO
-        UINT32 set_num = blk_id / set_block_size;
-        UINT32 Start = set_num * set_block_size;
-        for(UINT32 i =0 ;i < set_block_size; i++){
-            if(m_replace_q[Start + i] == blk_id){
-                for(UINT32 j = i + 1; j < set_block_size; j++){
-                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
-                }
-                m_replace_q[Start + set_block_size - 1] = blk_id;
-                break;
-            }
-        } 
+// Publish the final counters, mark the page finished and remove it
+void closeStats()
+{
+    if (!my_stats_on) return;
+    publishStats(0, 0, true);
+    my_stats.close();
+    my_stats_on = false;
+}
+
+VOID statsThread(VOID* arg)
+{
+    while (!__atomic_load_n(&my_stats_stop, __ATOMIC_ACQUIRE))
+    {
+        // 分段睡眠, 使进程结束时能及时退出
+        for (UINT32 t = 0; t < my_stats_period && !__atomic_load_n(&my_stats_stop, __ATOMIC_ACQUIRE); t += 100)
+            PIN_Sleep(std::min(my_stats_period - t, 100u));
+        publishStats(sumRepeats(false), sumRepeats(true), false);
     }
-};
+}
+
+VOID StatsPrepareForFini(VOID* v)
+{
+    __atomic_store_n(&my_stats_stop, true, __ATOMIC_RELEASE);
+    PIN_WaitForThreadTermination(my_stats_uid, PIN_INFINITE_TIMEOUT, NULL);
+}
 
 /**************************************
- * Set-Associative Cache Class (VIPT)
+ * Same-Line Filter
 **************************************/
-class SetAssoCache_VIPT : public CacheModel
+// 同一线程连续两次访问落在同一行时, 后一次访问在所有数据cache模型中必然命中,
+// 且命中MRU块不改变替换状态, 因此可以跳过模型, 只在最后按读写分别累加命中数.
+// 行大小取所有数据cache模型中最小的块大小; 每个线程上一次访问的行号保存在一个
+// Pin工具寄存器中, 判断函数足够简单, 可以被Pin内联.
+// 多线程共享模型时, 其它线程的访问可能已经把该行换出, 此时结果是近似的.
+#define FILTER_MAX_THREADS  256
+
+struct RepeatCount
 {
-public:
-     // Constructor
-    SetAssoCache_VIPT(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
-        this->set_block_size = set_block_size;
-        this->set_num_log = set_num_log;
-    }
-
-    // Destructor
-    ~SetAssoCache_VIPT() {}
+    UINT64 rd;
+    UINT64 wr;
+    UINT8 pad[48];          // 每个线程独占一个cache行, 避免伪共享
+};
 
-private:
+RepeatCount my_repeats[FILTER_MAX_THREADS];
+UINT32 my_filter_log;
+REG my_last_line_reg;
 
-    // Add your members
-    UINT32 set_num_log;
-    UINT32 set_block_size;
+// If-call: return non-zero when the access leaves the last line of this thread
+ADDRINT PIN_FAST_ANALYSIS_CALL readLineChanged(ADDRINT mem_addr, ADDRINT last_line, THREADID tid)
+{
+    ADDRINT line = mem_addr >> my_filter_log;
+    my_repeats[tid % FILTER_MAX_THREADS].rd += (line == last_line);
+    return line != last_line;
+}
 
-    //tag
-    UINT32 get_tag(UINT32 mem_addr){
-        return get_phy_addr(mem_addr) >> (set_num_log + PAGE_SIZE_LOG);
-    }
+ADDRINT PIN_FAST_ANALYSIS_CALL writeLineChanged(ADDRINT mem_addr, ADDRINT last_line, THREADID tid)
+{
+    ADDRINT line = mem_addr >> my_filter_log;
+    my_repeats[tid % FILTER_MAX_THREADS].wr += (line == last_line);
+    return line != last_line;
+}
 
-    UINT32 get_set_num(UINT32 mem_addr){
-        return ((mem_addr << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
-    }
+// Then-call: run the full models and return the new last line
+ADDRINT readCacheFiltered(ADDRINT mem_addr, THREADID tid)
+{
+    if (my_async_on) readEnqueue(mem_addr, tid);
+    else readCache(mem_addr, tid);
+    return mem_addr >> my_filter_log;
+}
 
-     // Look up the cache to decide whether the access is hit or missed
-    bool lookup(UINT32 mem_addr, UINT32& blk_id)
-    {
-        // TODO
-        UINT32 tag =  get_tag(mem_addr);
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 Start  = set_num * set_block_size;
-        for(UINT32 i = 0; i < set_block_size; i++){
-            blk_id = Start + i;
-            if(m_tags[Start + i] == tag){
-                
-                if(m_valids[Start + i] == true){
-                    return true;
-                }
-                else{
-                    return false;
-                }
-            }
-        }
-        return false;
-    }
+ADDRINT writeCacheFiltered(ADDRINT mem_addr, THREADID tid)
+{
+    if (my_async_on) writeEnqueue(mem_addr, tid);
+    else writeCache(mem_addr, tid);
+    return mem_addr >> my_filter_log;
+}
 
-    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
-    bool access(UINT32 mem_addr)
-    {
-        // TODO
-        UINT32 blk_id;
-        if(lookup(mem_addr, blk_id)){
-            updateReplaceQ(blk_id);
-            return true;
-        }
+VOID ThreadStart(THREADID tid, CONTEXT* ctxt, INT32 flags, VOID* v)
+{
+    PIN_SetContextReg(ctxt, my_last_line_reg, ~(ADDRINT)0);
+}
 
-        UINT32 set_num = get_set_num(mem_addr);
-        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
-        m_tags[bid_2be_replaced] = get_tag(mem_addr);
-        m_valids[bid_2be_replaced] = true;
-        updateReplaceQ(bid_2be_replaced);
-        return false;
-    }
-
-    // Update m_replace_q
-    void updateReplaceQ(UINT32 blk_id)
-    {
-        // TODO
-        UINT32 set_num = blk_id / set_block_size;
-        UINT32 Start = set_num * set_block_size;
-        for(UINT32 i =0 ;i < set_block_size; i++){
-            if(m_replace_q[Start + i] == blk_id){
-                for(UINT32 j = i + 1; j < set_block_size; j++){
-                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
-                }
-                m_replace_q[Start + set_block_size - 1] = blk_id;
-                break;
-            }
-        } 
-    }
-};
+// Repeated reads (or writes) skipped by the filter so far
+UINT64 sumRepeats(bool is_write)
+{
+    UINT64 sum = 0;
+    for (UINT32 i = 0; i < FILTER_MAX_THREADS; i++)
+        sum += is_write ? my_repeats[i].wr : my_repeats[i].rd;
+    return sum;
+}
 
-CacheModel* my_fa_cache;
-CacheModel* my_sa_cache;
-CacheModel* my_sa_cache_vivt;
-CacheModel* my_sa_cache_pipt;
-CacheModel* my_sa_cache_vipt;
+/**************************************
+ * StatCache Mode
+**************************************/
+// 低开销模式: 不运行精确模型, 每次访存只执行一个可内联的判断 (采样倒计数归零,
+// 或者访问的行可能正被监视), 只有判断成立时才调用慢路径.
+// 监视表按行号低位计数, 计数非0表示"可能"在监视, 由慢路径精确确认.
+// 倒计数和访问时钟是全局的, 多线程时为近似值: 快速路径的递减不是原子的, 可能丢失,
+// 也可能有几个线程同时把它减到0以下, 因此按有符号数判断 <= 0, 不会回绕后停止采样;
+// 慢路径持锁执行, 用CAS重置倒计数, 重置期间其它线程的递减计入下一个间隔.
+#define STAT_WATCH_BITS     16
+
+StatCacheSampler* my_stat = NULL;
+UINT32 my_stat_line_log;
+UINT64 my_stat_countdown;           // 距下一次采样的访问次数, 按有符号数解释
+UINT64 my_stat_interval;            // 本次采样间隔的长度
+UINT64 my_stat_clock;               // 本次采样间隔开始时的访问序号
+UINT8 my_stat_watch[1 << STAT_WATCH_BITS];
+PIN_LOCK my_stat_lock;
+
+ADDRINT PIN_FAST_ANALYSIS_CALL statNeedsCheck(ADDRINT mem_addr)
+{
+    return ((INT64)--my_stat_countdown <= 0) | my_stat_watch[(mem_addr >> my_stat_line_log) & ((1 << STAT_WATCH_BITS) - 1)];
+}
 
-// Cache reading analysis routine
-void readCache(UINT32 mem_addr)
+void statAccess(ADDRINT mem_addr, THREADID tid)
 {
-    mem_addr = (mem_addr >> 2) << 2;
+    PIN_GetLock(&my_stat_lock, tid + 1);
+    UINT64 line = mem_addr >> my_stat_line_log;
+    UINT8& watch = my_stat_watch[line & ((1 << STAT_WATCH_BITS) - 1)];
+    UINT64 count = __atomic_load_n(&my_stat_countdown, __ATOMIC_RELAXED);
+    UINT64 now = my_stat_clock + my_stat_interval - count;
 
-    my_fa_cache->readReq(mem_addr);
-    my_sa_cache->readReq(mem_addr);
+    if (watch && my_stat->reuse(line, now))
+        watch--;
 
-    my_sa_cache_vivt->readReq(mem_addr);
-    my_sa_cache_pipt->readReq(mem_addr);
-    my_sa_cache_vipt->readReq(mem_addr);
+    if ((INT64)count <= 0)
+    {
+        if (!my_stat->isWatched(line) && watch < 255)
+        {
+            my_stat->sample(line, now);
+            watch++;
+        }
+        my_stat_clock = now;
+        my_stat_interval = my_stat->nextInterval();
+
+        // 从读出count到现在其它线程又递减了count - cur次, 从新间隔中扣除
+        UINT64 cur = count;
+        while (!__atomic_compare_exchange_n(&my_stat_countdown, &cur, my_stat_interval - (count - cur),
+                                            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+    }
+    PIN_ReleaseLock(&my_stat_lock);
 }
 
-// Cache writing analysis routine
-void writeCache(UINT32 mem_addr)
-{
-    mem_addr = (mem_addr >> 2) << 2;
-
-    my_fa_cache->writeReq(mem_addr);
-    my_sa_cache->writeReq(mem_addr);
+// 记录模式: 把访存流压缩写入文件, 供离线重放
+MemTraceWriter my_trace;
+bool my_trace_on = false;
+PIN_LOCK my_trace_lock;
 
-    my_sa_cache_vivt->writeReq(mem_addr);
-    my_sa_cache_pipt->writeReq(mem_addr);
-    my_sa_cache_vipt->writeReq(mem_addr);
+// Trace recording analysis routine
+void recordAccess(THREADID tid, ADDRINT pc, ADDRINT mem_addr, UINT32 size, BOOL is_write)
+{
+    MemAccess rec;
+    rec.pc = pc;
+    rec.addr = mem_addr;
+    rec.tid = tid;
+    rec.size = size;
+    rec.is_write = is_write;
+
+    PIN_GetLock(&my_trace_lock, tid + 1);
+    my_trace.append(rec);
+    PIN_ReleaseLock(&my_trace_lock);
 }
 
 // This knob will set the cache param m_block_num
@@ -596,18 +542,381 @@ KNOB<UINT32> KnobSetsLog(KNOB_MODE_WRITEONCE, "pintool",
 KNOB<UINT32> KnobAssociativity(KNOB_MODE_WRITEONCE, "pintool",
         "a", "4", "specify the m_asso");
 
+// These knobs configure the way-partitioned shared LLC
+KNOB<UINT32> KnobLLCSetsLog(KNOB_MODE_WRITEONCE, "pintool",
+        "llc_sets", "10", "specify the log of the number of sets of the partitioned LLC");
+KNOB<UINT32> KnobLLCAsso(KNOB_MODE_WRITEONCE, "pintool",
+        "llc_asso", "16", "specify the associativity of the partitioned LLC (at most 64)");
+KNOB<UINT32> KnobLLCBlockSizeLog(KNOB_MODE_WRITEONCE, "pintool",
+        "llc_b", "6", "specify the log of the block size of the partitioned LLC");
+KNOB<UINT32> KnobLLCOwners(KNOB_MODE_WRITEONCE, "pintool",
+        "llc_owners", "4", "specify the number of owners (threads, modulo) of the partitioned LLC");
+KNOB<std::string> KnobCATMasks(KNOB_MODE_WRITEONCE, "pintool",
+        "cat_masks", "", "specify the comma-separated way masks of owners 0, 1, ... (empty: no partitioning)");
+KNOB<UINT32> KnobUMONSampleLog(KNOB_MODE_WRITEONCE, "pintool",
+        "umon_sample", "5", "specify the log of the set sampling ratio of the utility monitors");
+
+// This knob moves the data cache models onto an internal simulator thread
+KNOB<BOOL> KnobAsync(KNOB_MODE_WRITEONCE, "pintool",
+        "async", "0", "queue the accesses of every thread and simulate them on a separate internal thread");
+
+// These knobs publish the running counters into shared memory
+KNOB<std::string> KnobStatsShm(KNOB_MODE_WRITEONCE, "pintool",
+        "stats_shm", "", "specify the POSIX shared memory name (e.g. /cacheModel) of the live stats page, "
+        "the pid is appended (empty: off)");
+KNOB<UINT32> KnobStatsPeriod(KNOB_MODE_WRITEONCE, "pintool",
+        "stats_period", "1000", "specify the period in milliseconds of updating the live stats page");
+
+// This knob enables the same-line filter
+KNOB<BOOL> KnobFilter(KNOB_MODE_WRITEONCE, "pintool",
+        "filter", "1", "skip the cache models for repeated accesses to the last line of a thread");
+
+// These knobs configure the StatCache mode
+KNOB<UINT32> KnobStatCache(KNOB_MODE_WRITEONCE, "pintool",
+        "statcache", "0", "sample one access per N on average and estimate miss-ratio curves instead of simulating (0: off)");
+KNOB<UINT32> KnobStatLineLog(KNOB_MODE_WRITEONCE, "pintool",
+        "statcache_b", "6", "specify the log of the line size of the StatCache mode");
+KNOB<std::string> KnobStatSizes(KNOB_MODE_WRITEONCE, "pintool",
+        "statcache_sizes", "8,18", "specify the range of the log of the cache sizes (in lines) to report");
+
+// This knob enables the Belady OPT upper bound
+KNOB<BOOL> KnobOpt(KNOB_MODE_WRITEONCE, "pintool",
+        "opt", "0", "record the access stream and report the hit rate of Belady OPT replacement");
+KNOB<UINT32> KnobOptMax(KNOB_MODE_WRITEONCE, "pintool",
+        "opt_max", "67108864", "specify the maximum number of accesses recorded for Belady OPT (4 bytes each)");
+
+// These knobs configure the data-aware compressed caches
+KNOB<BOOL> KnobCompress(KNOB_MODE_WRITEONCE, "pintool",
+        "compress", "0", "read the accessed lines and model BDI/FPC compressed caches against an uncompressed one");
+KNOB<UINT32> KnobCompSetsLog(KNOB_MODE_WRITEONCE, "pintool",
+        "comp_sets", "7", "specify the log of the number of sets of the compressed caches");
+KNOB<UINT32> KnobCompAsso(KNOB_MODE_WRITEONCE, "pintool",
+        "comp_asso", "4", "specify the uncompressed associativity of the compressed caches");
+KNOB<UINT32> KnobCompBlockSizeLog(KNOB_MODE_WRITEONCE, "pintool",
+        "comp_b", "6", "specify the log of the block size of the compressed caches (3 to 8)");
+
+// These knobs enable the sector cache and the line size sweep
+KNOB<std::string> KnobSector(KNOB_MODE_WRITEONCE, "pintool",
+        "sector", "", "specify sets_log,asso,sector_log,sub_block_log of a sector cache (empty: off)");
+KNOB<std::string> KnobLineSweep(KNOB_MODE_WRITEONCE, "pintool",
+        "line_sweep", "", "specify capacity_log,asso,min_line_log,max_line_log to evaluate several line sizes in one pass (empty: off)");
+
+// This knob enables the recording mode
+KNOB<std::string> KnobTraceFile(KNOB_MODE_WRITEONCE, "pintool",
+        "trace", "", "specify the file to record the compressed access stream into (empty: no recording)");
+
+// These knobs configure the L1 instruction cache
+KNOB<UINT32> KnobICacheSetsLog(KNOB_MODE_WRITEONCE, "pintool",
+        "icache_sets", "6", "specify the log of the number of L1I sets");
+KNOB<UINT32> KnobICacheAsso(KNOB_MODE_WRITEONCE, "pintool",
+        "icache_asso", "8", "specify the L1I associativity");
+KNOB<UINT32> KnobICacheBlockSizeLog(KNOB_MODE_WRITEONCE, "pintool",
+        "icache_b", "6", "specify the log of the L1I block size in bytes");
+
+// This knob will set the slice-selection masks of the multi-slice LLC hash
+KNOB<std::string> KnobSliceMasks(KNOB_MODE_WRITEONCE, "pintool",
+        "slice_masks", "0x2a5b9,0x1d36e", "specify the comma-separated block-address masks of the LLC slice hash");
+
+// Parse a comma-separated list of hex masks, return the number of masks parsed
+template <typename T>
+UINT32 parseMasks(const std::string& str, T* masks, UINT32 max_num)
+{
+    UINT32 num = 0;
+    const char* p = str.c_str();
+    while (*p && num < max_num)
+    {
+        char* end;
+        T mask = strtoull(p, &end, 16);
+        if (end == p) break;
+        masks[num++] = mask;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return num;
+}
+
+// These knobs configure the DRAM model behind the PIPT cache
+KNOB<UINT32> KnobDramChLog(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_ch", "0", "specify the log of the number of DRAM channels");
+KNOB<UINT32> KnobDramRankLog(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_rank", "1", "specify the log of the number of ranks per channel");
+KNOB<UINT32> KnobDramBankLog(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_bank", "3", "specify the log of the number of banks per rank");
+KNOB<UINT32> KnobDramColLog(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_col", "13", "specify the log of the row-buffer size in bytes");
+KNOB<std::string> KnobDramMapping(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_map", "ro:ra:ba:ch:co", "specify the DRAM address mapping from MSB to LSB");
+KNOB<std::string> KnobDramPage(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_page", "open", "specify the row-buffer policy (open or closed)");
+KNOB<UINT32> KnobDramQueue(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_queue", "16", "specify the depth of the per-channel request queue");
+KNOB<std::string> KnobDramTiming(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_timing", "16,16,16,4", "specify tCL,tRCD,tRP,tBurst in DRAM cycles");
+KNOB<std::string> KnobDramClock(KNOB_MODE_WRITEONCE, "pintool",
+        "dram_clock", "3,2.5", "specify CPU cycles per memory access and CPU cycles per DRAM cycle");
+
+// These knobs limit the instrumentation to a region of interest
+KNOB<std::string> KnobROIImages(KNOB_MODE_WRITEONCE, "pintool",
+        "roi_images", "", "specify comma-separated substrings of the image names to instrument (empty: all)");
+KNOB<std::string> KnobROIRtns(KNOB_MODE_WRITEONCE, "pintool",
+        "roi_rtns", "", "specify comma-separated names of the routines to instrument (empty: all)");
+KNOB<std::string> KnobROIRanges(KNOB_MODE_WRITEONCE, "pintool",
+        "roi_ranges", "", "specify comma-separated hex address ranges lo-hi to instrument (empty: all)");
+KNOB<BOOL> KnobROIMarkers(KNOB_MODE_WRITEONCE, "pintool",
+        "roi_markers", "0", "start simulating at xchg %rbx,%rbx and stop at xchg %rcx,%rcx");
+KNOB<std::string> KnobROIFunc(KNOB_MODE_WRITEONCE, "pintool",
+        "roi_func", "", "simulate only between the entry and the exit of the named function");
+
+/**************************************
+ * Region of Interest
+**************************************/
+// 静态范围: 只插桩名字匹配的映像/函数以及给定地址范围内的指令.
+// 动态范围: 由标记指令或指定函数的入口/出口开关, 关闭时除标记外不插任何分析调用.
+// 状态改变时用PIN_RemoveInstrumentation清空代码缓存, 并用PIN_ExecuteAt从当前指令
+// 重新执行, 使后续代码按新的状态重新插桩. 状态是全局的, 多线程时按最先到达者切换.
+std::vector<std::string> my_roi_images;
+std::vector<std::string> my_roi_rtns;
+std::vector<std::pair<ADDRINT, ADDRINT> > my_roi_ranges;
+bool my_roi_dynamic = false;    // 是否由标记或函数开关
+bool my_roi_active = true;      // 当前是否在感兴趣区域内
+UINT32 my_roi_depth = 0;        // roi_func的嵌套深度
+UINT64 my_roi_toggles = 0;
+
+// Split a comma-separated list
+std::vector<std::string> splitList(const std::string& str)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start < str.size())
+    {
+        size_t end = str.find(',', start);
+        if (end == std::string::npos) end = str.size();
+        if (end > start) items.push_back(str.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+// Whether ins belongs to the static region of interest
+bool inScope(INS ins)
+{
+    ADDRINT addr = INS_Address(ins);
+    if (!my_roi_ranges.empty())
+    {
+        bool hit = false;
+        for (size_t i = 0; i < my_roi_ranges.size() && !hit; i++)
+            hit = addr >= my_roi_ranges[i].first && addr < my_roi_ranges[i].second;
+        if (!hit) return false;
+    }
+    if (!my_roi_images.empty())
+    {
+        IMG img = IMG_FindByAddress(addr);
+        if (!IMG_Valid(img)) return false;
+        bool hit = false;
+        for (size_t i = 0; i < my_roi_images.size() && !hit; i++)
+            hit = IMG_Name(img).find(my_roi_images[i]) != std::string::npos;
+        if (!hit) return false;
+    }
+    if (!my_roi_rtns.empty())
+    {
+        RTN rtn = INS_Rtn(ins);
+        if (!RTN_Valid(rtn)) return false;
+        return std::find(my_roi_rtns.begin(), my_roi_rtns.end(), RTN_Name(rtn)) != my_roi_rtns.end();
+    }
+    return true;
+}
+
+// Switch the region on or off and re-execute the current instruction under the new instrumentation
+void roiSwitch(bool active, CONTEXT* ctxt)
+{
+    my_roi_active = active;
+    my_roi_toggles++;
+    PIN_RemoveInstrumentation();
+    PIN_ExecuteAt(ctxt);
+}
+
+// Analysis routine of the marker instructions
+void roiMarker(BOOL start, CONTEXT* ctxt)
+{
+    if (my_roi_active != (bool)start) roiSwitch(start, ctxt);
+}
+
+// 重新执行时入口/出口调用会再次运行, 此时状态已经切换, 只需恢复深度
+void roiEnter(CONTEXT* ctxt)
+{
+    if (my_roi_depth++ == 0 && !my_roi_active)
+    {
+        my_roi_depth--;
+        roiSwitch(true, ctxt);
+    }
+}
+
+void roiExit(CONTEXT* ctxt)
+{
+    if (my_roi_depth > 0 && --my_roi_depth == 0 && my_roi_active)
+    {
+        my_roi_depth++;
+        roiSwitch(false, ctxt);
+    }
+}
+
+// Pin calls this function for every loaded image: hook the entry and the exits of roi_func
+VOID ImageLoad(IMG img, VOID* v)
+{
+    RTN rtn = RTN_FindByName(img, KnobROIFunc.Value().c_str());
+    if (!RTN_Valid(rtn)) return;
+    RTN_Open(rtn);
+    RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)roiEnter, IARG_CONTEXT, IARG_END);
+    RTN_InsertCall(rtn, IPOINT_AFTER, (AFUNPTR)roiExit, IARG_CONTEXT, IARG_END);
+    RTN_Close(rtn);
+}
+
+// Return 1 for the start marker xchg %rbx,%rbx, 2 for the stop marker xchg %rcx,%rcx, otherwise 0
+UINT32 markerKind(INS ins)
+{
+    if (!INS_IsXchg(ins) || !INS_OperandIsReg(ins, 0) || !INS_OperandIsReg(ins, 1)) return 0;
+    REG reg = INS_OperandReg(ins, 0);
+    if (reg != INS_OperandReg(ins, 1)) return 0;
+    if (REG_FullRegName(reg) == REG_GBX) return 1;
+    if (REG_FullRegName(reg) == REG_GCX) return 2;
+    return 0;
+}
+
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID *v)
 {
-    if (INS_IsMemoryRead(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)readCache, IARG_MEMORYREAD_EA, IARG_END);
-    if (INS_IsMemoryWrite(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)writeCache, IARG_MEMORYWRITE_EA, IARG_END);
+    if (KnobROIMarkers.Value())
+    {
+        UINT32 kind = markerKind(ins);
+        if (kind)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)roiMarker, IARG_BOOL, kind == 1, IARG_CONTEXT, IARG_END);
+    }
+    if (!my_roi_active || !inScope(ins)) return;
+
+    if (my_stat)
+    {
+        if (INS_IsMemoryRead(ins))
+        {
+            INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)statNeedsCheck, IARG_FAST_ANALYSIS_CALL,
+                             IARG_MEMORYREAD_EA, IARG_END);
+            INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)statAccess, IARG_MEMORYREAD_EA, IARG_THREAD_ID, IARG_END);
+        }
+        if (INS_IsMemoryWrite(ins))
+        {
+            INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)statNeedsCheck, IARG_FAST_ANALYSIS_CALL,
+                             IARG_MEMORYWRITE_EA, IARG_END);
+            INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)statAccess, IARG_MEMORYWRITE_EA, IARG_THREAD_ID, IARG_END);
+        }
+        return;
+    }
+
+    if (REG_valid(my_last_line_reg))
+    {
+        if (INS_IsMemoryRead(ins))
+        {
+            INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)readLineChanged, IARG_FAST_ANALYSIS_CALL,
+                             IARG_MEMORYREAD_EA, IARG_REG_VALUE, my_last_line_reg, IARG_THREAD_ID, IARG_END);
+            INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)readCacheFiltered,
+                               IARG_MEMORYREAD_EA, IARG_THREAD_ID, IARG_RETURN_REGS, my_last_line_reg, IARG_END);
+        }
+        if (INS_IsMemoryWrite(ins))
+        {
+            INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)writeLineChanged, IARG_FAST_ANALYSIS_CALL,
+                             IARG_MEMORYWRITE_EA, IARG_REG_VALUE, my_last_line_reg, IARG_THREAD_ID, IARG_END);
+            INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)writeCacheFiltered,
+                               IARG_MEMORYWRITE_EA, IARG_THREAD_ID, IARG_RETURN_REGS, my_last_line_reg, IARG_END);
+        }
+    }
+    else
+    {
+        AFUNPTR rd = my_async_on ? (AFUNPTR)readEnqueue : (AFUNPTR)readCache;
+        AFUNPTR wr = my_async_on ? (AFUNPTR)writeEnqueue : (AFUNPTR)writeCache;
+        if (INS_IsMemoryRead(ins))
+            INS_InsertCall(ins, IPOINT_BEFORE, rd, IARG_MEMORYREAD_EA, IARG_THREAD_ID, IARG_END);
+        if (INS_IsMemoryWrite(ins))
+            INS_InsertCall(ins, IPOINT_BEFORE, wr, IARG_MEMORYWRITE_EA, IARG_THREAD_ID, IARG_END);
+    }
+
+    if (my_comp_bdi)
+    {
+        if (INS_IsMemoryRead(ins))
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)compressAccess, IARG_MEMORYREAD_EA, IARG_BOOL, FALSE, IARG_END);
+        if (INS_IsMemoryWrite(ins))
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)compressAccess, IARG_MEMORYWRITE_EA, IARG_BOOL, TRUE, IARG_END);
+    }
+
+    if (my_trace_on)
+    {
+        if (INS_IsMemoryRead(ins))
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)recordAccess, IARG_THREAD_ID, IARG_INST_PTR,
+                           IARG_MEMORYREAD_EA, IARG_MEMORYREAD_SIZE, IARG_BOOL, FALSE, IARG_END);
+        if (INS_IsMemoryWrite(ins))
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)recordAccess, IARG_THREAD_ID, IARG_INST_PTR,
+                           IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_BOOL, TRUE, IARG_END);
+    }
+}
+
+// Pin calls this function every time a new trace is encountered
+// 每个基本块只插入一次取指调用, 覆盖它所跨越的全部cache行
+VOID Trace(TRACE trace, VOID *v)
+{
+    if (my_stat || !my_roi_active) return;
+
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    {
+        if (!inScope(BBL_InsHead(bbl))) continue;
+
+        ADDRINT first = BBL_Address(bbl) >> my_icache_blksz_log;
+        ADDRINT last = (BBL_Address(bbl) + BBL_Size(bbl) - 1) >> my_icache_blksz_log;
+        BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)fetchBlock,
+                       IARG_UINT32, (UINT32)(first << my_icache_blksz_log),
+                       IARG_UINT32, (UINT32)(last - first + 1), IARG_END);
+    }
 }
 
 // This function is called when the application exits
 VOID Fini(INT32 code, VOID *v)
 {
+    // StatCache模式下精确模型没有被插桩, 只输出估计的缺失率曲线
+    if (my_stat)
+    {
+        closeStats();
+        UINT32 min_log = 8, max_log = 18;
+        sscanf(KnobStatSizes.Value().c_str(), "%u,%u", &min_log, &max_log);
+        printf("\nStatCache estimate (1 sample per %u accesses, %u-byte lines):\n",
+               KnobStatCache.Value(), 1u << my_stat_line_log);
+        my_stat->dumpResults(min_log, max_log, my_stat_line_log);
+        delete my_stat;
+        return;
+    }
+
+    if (my_async_on)
+    {
+        // 模拟线程最后一次清空之后入队的记录
+        PIN_GetLock(&my_async_lock, 1);
+        UINT64 stalls = 0, leftover = 0;
+        for (UINT32 i = 0; i < ASYNC_MAX_THREADS; i++)
+        {
+            if (!my_rings[i]) continue;
+            leftover += drainRing(i, ~0ul);
+            stalls += my_rings[i]->stalls;
+        }
+        PIN_ReleaseLock(&my_async_lock);
+        printf("\nAsynchronous simulation: %lu full-queue stalls, %lu accesses dropped, "
+               "%lu simulated after the simulator thread exited, %lu left in the queues\n",
+               stalls, my_async_dropped, my_async_late, leftover);
+    }
+
+    if (my_roi_dynamic)
+        printf("\nRegion of interest: switched %lu times\n", my_roi_toggles);
+
+    // Credit the repeated accesses skipped by the same-line filter
+    UINT64 rd_repeats = sumRepeats(false), wr_repeats = sumRepeats(true);
+    for (size_t i = 0; i < my_data_models.size(); i++)
+        my_data_models[i]->creditHits(rd_repeats, wr_repeats);
+    for (UINT32 i = 0; i < FILTER_MAX_THREADS; i++)
+        my_llc_part->creditOwnerHits(i, my_repeats[i].rd + my_repeats[i].wr);
+
+    closeStats();
     printf("\nFully Associative Cache:\n");
     my_fa_cache->dumpResults();
 
@@ -623,18 +932,128 @@ VOID Fini(INT32 code, VOID *v)
     printf("\nSet-Associative Cache (VIPT):\n");
     my_sa_cache_vipt->dumpResults();
 
+    printf("\nSet-Associative Cache (bit-slice index):\n");
+    my_sa_cache_slice->dumpResults();
+
+    printf("\nSet-Associative Cache (XOR-folded index):\n");
+    my_sa_cache_xor->dumpResults();
+
+    printf("\nSkewed-Associative Cache:\n");
+    my_sa_cache_skew->dumpResults();
+
+    printf("\nSet-Associative Cache (sliced LLC hash):\n");
+    my_sa_cache_llc->dumpResults();
+
+    printf("\nWay-Partitioned LLC:\n");
+    my_llc_part->dumpResults();
+    my_llc_part->dumpPartition();
+
+    if (my_sector)
+    {
+        printf("\nSector Cache:\n");
+        my_sector->dumpResults();
+    }
+
+    if (my_sweep)
+    {
+        printf("\nLine Size Sweep:\n");
+        my_sweep->dumpResults();
+    }
+
+    if (my_opt)
+    {
+        // 被同行过滤跳过的重复访问在OPT中同样必然命中
+        // 记录满过时, 重复访问数和LRU的缺失数都取停止记录时的值
+        UINT64 lru_misses = my_sa_cache_slice->getMisses();
+        if (!my_opt_rec)
+        {
+            lru_misses = my_opt_lru_misses;
+            rd_repeats = my_opt_rd_repeats;
+            wr_repeats = my_opt_wr_repeats;
+        }
+        my_opt->simulate();
+        my_opt->creditHits(rd_repeats, wr_repeats);
+
+        printf("\nBelady OPT (same geometry as bit-slice index):\n");
+        if (!my_opt_rec)
+            printf("\tonly the first %lu accesses were recorded\n", my_opt->getRecorded());
+        my_opt->dumpResults();
+        UINT64 reqs = my_opt->getRdReq() + my_opt->getWrReq();
+        if (reqs)
+            printf("\tmiss rate gap to LRU: %.2f%%\n", 100.0 * ((double)lru_misses - my_opt->getMisses()) / reqs);
+    }
+
+    if (my_comp_bdi)
+    {
+        CompressedCache* comp[] = { my_comp_bdi, my_comp_fpc };
+        const char* names[] = { "BDI", "FPC" };
+        UINT64 reqs = my_comp_base->getRdReq() + my_comp_base->getWrReq();
+        printf("\nUncompressed Cache (baseline of the compressed caches):\n");
+        my_comp_base->dumpResults();
+        for (int i = 0; i < 2; i++)
+        {
+            printf("\nCompressed Cache (%s):\n", names[i]);
+            comp[i]->dumpResults();
+            comp[i]->dumpCompression();
+            if (reqs)
+                printf("\thit rate gain: %.2f%%\n",
+                       100.0 * ((double)my_comp_base->getMisses() - comp[i]->getMisses()) / reqs);
+        }
+    }
+
+    printf("\nInstruction Cache (L1I):\n");
+    my_icache->dumpResults();
+
+    printf("\nDRAM (behind PIPT cache):\n");
+    my_dram->drain();
+    my_dram->dumpResults();
+
+    // 与位切片映射的缺失数之差即哈希消除 (或引入) 的冲突缺失
+    UINT64 base_misses = my_sa_cache_slice->getMisses();
+    CacheModel* hashed[] = { my_sa_cache_xor, my_sa_cache_skew, my_sa_cache_llc };
+    const char* names[] = { "XOR-folded", "skewed", "sliced LLC" };
+    printf("\nConflict misses removed relative to bit-slice index (%lu misses):\n", base_misses);
+    for (int i = 0; i < 3; i++)
+    {
+        INT64 removed = (INT64)base_misses - (INT64)hashed[i]->getMisses();
+        printf("\t%s:\t%ld (%.2f%%)\n", names[i], removed, base_misses ? 100.0 * removed / base_misses : 0.0);
+    }
+
     delete my_fa_cache;
     delete my_sa_cache;
 
     delete my_sa_cache_vivt;
     delete my_sa_cache_pipt;
     delete my_sa_cache_vipt;
+
+    delete my_sa_cache_slice;
+    delete my_sa_cache_xor;
+    delete my_sa_cache_skew;
+    delete my_sa_cache_llc;
+    delete my_llc_part;
+
+    delete my_icache;
+    delete my_dram;
+    delete my_opt;
+    delete my_sector;
+    delete my_sweep;
+    delete my_comp_bdi;
+    delete my_comp_fpc;
+    delete my_comp_base;
+
+    if (my_trace_on)
+    {
+        printf("\nRecorded %lu accesses into %s\n", my_trace.getRecNum(), KnobTraceFile.Value().c_str());
+        if (!my_trace.close())
+            fprintf(stderr, "error writing trace file %s, the trace is incomplete\n", KnobTraceFile.Value().c_str());
+    }
 }
 
 // argc, argv are the entire command line, including pin -t <toolname> -- ...
 int main(int argc, char* argv[])
 {
     // Initialize pin
+    PIN_InitSymbols();
     PIN_Init(argc, argv);
 
     my_fa_cache = new FullAssoCache(256, 4);
@@ -644,15 +1063,162 @@ int main(int argc, char* argv[])
     my_sa_cache_pipt = new SetAssoCache_PIPT(7, 4, 4);
     my_sa_cache_vipt = new SetAssoCache_VIPT(7,3, 3);
 
+    my_icache_blksz_log = KnobICacheBlockSizeLog.Value();
+    my_icache = new SetAssoCache_Hashed(KnobICacheSetsLog.Value(), KnobICacheAsso.Value(),
+                                        my_icache_blksz_log, new BitSliceIndex(KnobICacheSetsLog.Value()));
+
+    my_dram = new DRAMModel(KnobDramChLog.Value(), KnobDramRankLog.Value(), KnobDramBankLog.Value(),
+                            KnobDramColLog.Value(), KnobDramMapping.Value(),
+                            KnobDramPage.Value() != "closed", KnobDramQueue.Value());
+    UINT32 tCL, tRCD, tRP, tBurst;
+    if (sscanf(KnobDramTiming.Value().c_str(), "%u,%u,%u,%u", &tCL, &tRCD, &tRP, &tBurst) == 4)
+        my_dram->setTiming(tCL, tRCD, tRP, tBurst);
+    double cpu_per_access, cpu_per_dram;
+    if (sscanf(KnobDramClock.Value().c_str(), "%lf,%lf", &cpu_per_access, &cpu_per_dram) == 2)
+        my_dram->setClock(cpu_per_access, cpu_per_dram);
+    my_sa_cache_pipt->setBackend(my_dram);
+
+    UINT32 slice_masks[7];
+    UINT32 slice_bits = parseMasks(KnobSliceMasks.Value(), slice_masks, 7);
+    my_sa_cache_slice = new SetAssoCache_Hashed(7, 3, 3, new BitSliceIndex(7));
+    my_sa_cache_xor = new SetAssoCache_Hashed(7, 3, 3, new XorFoldIndex(7));
+    my_sa_cache_skew = new SkewedAssoCache(7, 3, 3, new SkewedIndex(7));
+    my_sa_cache_llc = new SetAssoCache_Hashed(7, 3, 3, new SliceHashIndex(7, slice_masks, slice_bits));
+
+    UINT64 cat_masks[32];
+    UINT32 cat_num = parseMasks(KnobCATMasks.Value(), cat_masks, 32);
+    my_llc_part = new SetAssoCache_Hashed(KnobLLCSetsLog.Value(), KnobLLCAsso.Value(), KnobLLCBlockSizeLog.Value(),
+                                          new BitSliceIndex(KnobLLCSetsLog.Value()));
+    my_llc_part->setOwnerNum(KnobLLCOwners.Value());
+    PIN_InitLock(&my_llc_lock);
+    for (UINT32 i = 0; i < cat_num; i++)
+        my_llc_part->setWayMask(i, cat_masks[i]);
+    my_llc_part->enableUMON(KnobUMONSampleLog.Value());
+
     // my_fa_cache = new SetAssoCache(1,3,3);
     // my_sa_cache = new SetAssoCache(3,3, 3);
     // my_sa_cache_vivt = new SetAssoCache(5,3, 3);
     // my_sa_cache_pipt = new SetAssoCache(7,3, 3);
     // my_sa_cache_vipt = new SetAssoCache(9,3, 3);
 
+    if (KnobStatCache.Value())
+    {
+        my_stat = new StatCacheSampler(KnobStatCache.Value());
+        my_stat_line_log = KnobStatLineLog.Value();
+        my_stat_interval = my_stat_countdown = my_stat->nextInterval();
+        my_stat_clock = 0;
+        PIN_InitLock(&my_stat_lock);
+    }
+
+    if (KnobOpt.Value())
+    {
+        my_opt = new BeladyOPTCache(7, 3, 3, KnobOptMax.Value());
+        my_opt_rec = my_opt;
+        PIN_InitLock(&my_opt_lock);
+    }
+
+    if (KnobCompress.Value())
+    {
+        UINT32 sets_log = KnobCompSetsLog.Value(), asso = KnobCompAsso.Value();
+        my_comp_blksz_log = std::min(std::max(KnobCompBlockSizeLog.Value(), 3u), (UINT32)COMP_MAX_BLKSZ_LOG);
+        my_comp_bdi = new CompressedCache(sets_log, asso, my_comp_blksz_log);
+        my_comp_fpc = new CompressedCache(sets_log, asso, my_comp_blksz_log);
+        my_comp_base = new SetAssoCache_Hashed(sets_log, asso, my_comp_blksz_log, new BitSliceIndex(sets_log));
+    }
+
+    // 所有由readCache/writeCache驱动的数据cache模型
+    CacheModel* data_models[] = { my_fa_cache, my_sa_cache, my_sa_cache_vivt, my_sa_cache_pipt, my_sa_cache_vipt,
+                                  my_sa_cache_slice, my_sa_cache_xor, my_sa_cache_skew, my_sa_cache_llc, my_llc_part };
+    const char* data_names[] = { "fully associative", "set-associative", "VIVT", "PIPT", "VIPT",
+                                 "bit-slice index", "XOR-folded index", "skewed", "sliced LLC hash", "way-partitioned LLC" };
+    my_data_models.assign(data_models, data_models + sizeof(data_models) / sizeof(data_models[0]));
+    my_data_names.assign(data_names, data_names + sizeof(data_names) / sizeof(data_names[0]));
+
+    UINT32 p0, p1, p2, p3;
+    if (sscanf(KnobSector.Value().c_str(), "%u,%u,%u,%u", &p0, &p1, &p2, &p3) == 4 && p2 >= p3 && p2 - p3 <= 6)
+    {
+        my_sector = new SectorCache(p0, p1, p2, p3);
+        my_data_models.push_back(my_sector);
+        my_data_names.push_back("sector");
+    }
+    if (sscanf(KnobLineSweep.Value().c_str(), "%u,%u,%u,%u", &p0, &p1, &p2, &p3) == 4 && p2 <= p3 && p3 < p0)
+    {
+        my_sweep = new LineSizeSweep(p0, p1, p2, p3);
+        for (size_t i = 0; i < my_sweep->size(); i++)
+        {
+            my_data_models.push_back((*my_sweep)[i]);
+            my_data_names.push_back("line sweep " + decstr(1u << (*my_sweep)[i]->getBlockSizeLog()) + "B");
+        }
+    }
+
+    my_last_line_reg = REG_INVALID();
+    if (KnobFilter.Value())
+    {
+        my_filter_log = 32;
+        for (size_t i = 0; i < my_data_models.size(); i++)
+            if (my_data_models[i]->getBlockSizeLog() < my_filter_log)
+                my_filter_log = my_data_models[i]->getBlockSizeLog();
+
+        my_last_line_reg = PIN_ClaimToolRegister();
+        PIN_AddThreadStartFunction(ThreadStart, 0);
+    }
+
+    if (KnobAsync.Value())
+    {
+        PIN_AddThreadStartFunction(AsyncThreadStart, 0);
+        PIN_InitLock(&my_async_lock);
+        my_async_on = PIN_SpawnInternalThread(simulatorThread, NULL, 0, &my_async_uid) != INVALID_THREADID;
+        if (my_async_on) PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
+        else fprintf(stderr, "cannot spawn the simulator thread, simulating synchronously\n");
+    }
+
+    if (!KnobStatsShm.Value().empty())
+    {
+        my_start_ms = nowMs();
+        my_stats_period = std::max(KnobStatsPeriod.Value(), 1u);
+        // 名字后加上pid, 同时运行的多个进程各用一个页面
+        std::string shm_name = KnobStatsShm.Value() + "." + decstr(PIN_GetPid());
+        if (!my_stats.open(shm_name.c_str(), PIN_GetPid()))
+            fprintf(stderr, "cannot create shared memory %s\n", shm_name.c_str());
+        else if (PIN_SpawnInternalThread(statsThread, NULL, 0, &my_stats_uid) == INVALID_THREADID)
+            my_stats.close();
+        else
+        {
+            my_stats_on = true;
+            PIN_AddPrepareForFiniFunction(StatsPrepareForFini, 0);
+            fprintf(stderr, "live statistics in shared memory %s\n", shm_name.c_str());
+        }
+    }
+
+    if (!KnobTraceFile.Value().empty())
+    {
+        my_trace_on = my_trace.open(KnobTraceFile.Value().c_str());
+        if (!my_trace_on)
+            fprintf(stderr, "cannot open trace file %s\n", KnobTraceFile.Value().c_str());
+        PIN_InitLock(&my_trace_lock);
+    }
+
+    my_roi_images = splitList(KnobROIImages.Value());
+    my_roi_rtns = splitList(KnobROIRtns.Value());
+    std::vector<std::string> ranges = splitList(KnobROIRanges.Value());
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        char* end;
+        ADDRINT lo = strtoull(ranges[i].c_str(), &end, 16);
+        if (*end == '-') my_roi_ranges.push_back(std::make_pair(lo, (ADDRINT)strtoull(end + 1, NULL, 16)));
+        else fprintf(stderr, "ignoring bad address range %s\n", ranges[i].c_str());
+    }
+    my_roi_dynamic = KnobROIMarkers.Value() || !KnobROIFunc.Value().empty();
+    my_roi_active = !my_roi_dynamic;
+    if (!KnobROIFunc.Value().empty())
+        IMG_AddInstrumentFunction(ImageLoad, 0);
+
     // Register Instruction to be called to instrument instructions
     INS_AddInstrumentFunction(Instruction, 0);
 
+    // Register Trace to be called to instrument instruction fetch per basic block
+    TRACE_AddInstrumentFunction(Trace, 0);
+
     // Register Fini to be called when the application exits
     PIN_AddFiniFunction(Fini, 0);
 
@@ -0,0 +1,2044 @@
+#ifndef CACHE_MODEL_H
+#define CACHE_MODEL_H
+
+// Cache and memory models shared by the Pin tool (cacheModel.cpp) and the
+// standalone tools; this header must not depend on pin.H.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+typedef unsigned char       UINT8;
+typedef short               INT16;
+typedef int                 INT32;
+typedef unsigned int        UINT32;
+typedef long int            INT64;
+typedef unsigned long int   UINT64;
+
+
+#define PAGE_SIZE_LOG       12
+#define PHY_MEM_SIZE_LOG    30
+
+//get page
+#define get_vir_page_no(virtual_addr)   (virtual_addr >> PAGE_SIZE_LOG)
+
+//get offset
+#define get_page_offset(addr)           (addr & ((1u << PAGE_SIZE_LOG) - 1))
+
+// Obtain physical page number according to a given virtual page number
+inline UINT32 get_phy_page_no(UINT32 virtual_page_no)
+{
+    UINT32 vpn = virtual_page_no;
+    vpn = (~vpn ^ (vpn << 16)) + (vpn & (vpn << 16)) + (~vpn | (vpn << 2));
+
+    UINT32 mask = (UINT32)(~0) << (32 - PHY_MEM_SIZE_LOG);
+    mask = mask >> (32 - PHY_MEM_SIZE_LOG + PAGE_SIZE_LOG);
+    mask = mask << PAGE_SIZE_LOG;
+
+    return vpn & mask;
+}
+
+// Transform a virtual address into a physical address
+inline UINT32 get_phy_addr(UINT32 virtual_addr)
+{
+    return (get_phy_page_no(get_vir_page_no(virtual_addr)) << PAGE_SIZE_LOG) + get_page_offset(virtual_addr);
+}
+
+/**************************************
+ * DRAM Model
+**************************************/
+// 最后一级cache的缺失请求送到这里, 地址按映射串拆分为 row/rank/bank/channel/column 各字段.
+// 注意: get_phy_addr产生的物理页号低位恒为0, 会把所有请求映射到同一个bank,
+// 因此这里直接使用cache看到的地址.
+// 时间以DRAM周期计. 调用者给出的到达时间是cache的访问序号, 按setClock给出的
+// 每次访问的CPU周期数和CPU:DRAM时钟比换算成DRAM周期.
+// 每个channel有一个请求队列和一个控制器时间线: 控制器空闲且已有请求到达时按FR-FCFS发射一个请求,
+// 只在已经到达的请求中优先选择命中已打开行的最早请求, 否则选择最早的请求;
+// 每个周期最多发射一个请求, 且控制器不超前数据总线. 新请求到达前, 时间线上早于它的发射先完成.
+// 队列满时处理器停顿: 新请求等到有请求发射、腾出空位时才进入队列, 之后所有访问的时间都顺延.
+// 延迟从请求进入队列算起, 包括排队时间.
+class DRAMModel
+{
+public:
+    // Constructor
+    // param:   ch_log/rank_log/bank_log:   channel/rank/bank个数的对数
+    //          col_log:                    行缓冲大小(字节)的对数
+    //          mapping:                    地址字段从高位到低位的顺序, 如"ro:ra:ba:ch:co"
+    //          open_page:                  true为open-page策略, false为closed-page策略
+    //          queue_depth:                每个channel请求队列的深度
+    DRAMModel(UINT32 ch_log, UINT32 rank_log, UINT32 bank_log, UINT32 col_log,
+              const std::string& mapping, bool open_page, UINT32 queue_depth)
+        : m_open_page(open_page), m_queue_depth(queue_depth),
+          m_tCL(16), m_tRCD(16), m_tRP(16), m_tBurst(4), m_cpu_per_access(3.0), m_cpu_per_dram(2.5),
+          m_row_hits(0), m_row_misses(0), m_row_conflicts(0), m_total_latency(0), m_stall(0)
+    {
+        if ((UINT64)ch_log + rank_log + bank_log + col_log >= 32)
+        {
+            fprintf(stderr, "DRAM: channel, rank, bank and column bits (%u) leave no row bits in a 32-bit address\n",
+                    ch_log + rank_log + bank_log + col_log);
+            exit(1);
+        }
+        m_bits[FIELD_CH] = ch_log;
+        m_bits[FIELD_RA] = rank_log;
+        m_bits[FIELD_BA] = bank_log;
+        m_bits[FIELD_CO] = col_log;
+        m_bits[FIELD_RO] = 32 - ch_log - rank_log - bank_log - col_log;
+        if (!parseMapping(mapping))
+        {
+            fprintf(stderr, "DRAM: mapping \"%s\" must list each of ro, ra, ba, ch and co exactly once, "
+                    "separated by ':'\n", mapping.c_str());
+            exit(1);
+        }
+        if (m_queue_depth == 0) m_queue_depth = 1;
+
+        m_ch_num = 1u << ch_log;
+        m_banks_per_ch = 1u << (rank_log + bank_log);
+        m_open_row = new INT64[m_ch_num * m_banks_per_ch];
+        m_bank_ready = new UINT64[m_ch_num * m_banks_per_ch];
+        m_bus_ready = new UINT64[m_ch_num];
+        m_ctrl_time = new UINT64[m_ch_num];
+        m_queues = new std::vector<DRAMReq>[m_ch_num];
+        for (UINT32 i = 0; i < m_ch_num * m_banks_per_ch; i++)
+        {
+            m_open_row[i] = -1;
+            m_bank_ready[i] = 0;
+        }
+        for (UINT32 i = 0; i < m_ch_num; i++)
+        {
+            m_bus_ready[i] = 0;
+            m_ctrl_time[i] = 0;
+        }
+    }
+
+    // Destructor
+    ~DRAMModel()
+    {
+        delete[] m_open_row;
+        delete[] m_bank_ready;
+        delete[] m_bus_ready;
+        delete[] m_ctrl_time;
+        delete[] m_queues;
+    }
+
+    // Set timing parameters (in DRAM cycles)
+    void setTiming(UINT32 tCL, UINT32 tRCD, UINT32 tRP, UINT32 tBurst)
+    {
+        m_tCL = tCL;
+        m_tRCD = tRCD;
+        m_tRP = tRP;
+        m_tBurst = tBurst;
+    }
+
+    // Set the clocks: CPU cycles between two cache accesses, and CPU cycles per DRAM cycle
+    void setClock(double cpu_per_access, double cpu_per_dram)
+    {
+        if (cpu_per_access > 0) m_cpu_per_access = cpu_per_access;
+        if (cpu_per_dram > 0) m_cpu_per_dram = cpu_per_dram;
+    }
+
+    // Enqueue a request which missed in the last cache level; access_no is the cache access count
+    void request(UINT32 mem_addr, bool is_write, UINT64 access_no)
+    {
+        DRAMReq req;
+        req.bank = (getField(mem_addr, FIELD_RA) << m_bits[FIELD_BA]) | getField(mem_addr, FIELD_BA);
+        req.row = getField(mem_addr, FIELD_RO);
+        req.arrival = (UINT64)(access_no * m_cpu_per_access / m_cpu_per_dram) + m_stall;
+        req.is_write = is_write;
+
+        UINT32 ch = getField(mem_addr, FIELD_CH);
+        std::vector<DRAMReq>& q = m_queues[ch];
+        // 控制器在新请求到达之前能做出的发射
+        while (!q.empty() && issueTime(ch) < req.arrival)
+            issue(ch);
+        // 队列满: 处理器停顿到腾出空位
+        while (q.size() >= m_queue_depth)
+        {
+            UINT64 t = issueTime(ch);
+            issue(ch);
+            if (t > req.arrival)
+            {
+                m_stall += t - req.arrival;
+                req.arrival = t;
+            }
+        }
+        q.push_back(req);
+    }
+
+    // Issue every request still waiting in the queues
+    void drain()
+    {
+        for (UINT32 ch = 0; ch < m_ch_num; ch++)
+            while (!m_queues[ch].empty())
+                issue(ch);
+    }
+
+    void dumpResults()
+    {
+        UINT64 total = m_row_hits + m_row_misses + m_row_conflicts;
+        double denom = total ? (double)total : 1.0;
+        printf("\trequests: %lu,\tpolicy: %s-page\n", total, m_open_page ? "open" : "closed");
+        printf("\trow hit: %lu (%.2f%%),\trow miss: %lu (%.2f%%),\trow conflict: %lu (%.2f%%)\n",
+               m_row_hits, 100 * m_row_hits / denom, m_row_misses, 100 * m_row_misses / denom,
+               m_row_conflicts, 100 * m_row_conflicts / denom);
+        printf("\taverage memory latency: %.2f DRAM cycles (%.2f CPU cycles, incl. queueing)\n",
+               m_total_latency / denom, m_total_latency / denom * m_cpu_per_dram);
+        printf("\tstall on full queues: %lu DRAM cycles\n", m_stall);
+    }
+
+private:
+    enum { FIELD_RO, FIELD_RA, FIELD_BA, FIELD_CH, FIELD_CO, FIELD_NUM };
+
+    struct DRAMReq
+    {
+        UINT32 bank;            // rank和bank拼接后的编号 (channel内)
+        UINT32 row;
+        UINT64 arrival;
+        bool is_write;
+    };
+
+    UINT32 m_bits[FIELD_NUM];   // 各字段位宽
+    UINT32 m_shift[FIELD_NUM];  // 各字段在地址中的起始位置
+
+    bool m_open_page;
+    UINT32 m_queue_depth;
+    UINT32 m_tCL, m_tRCD, m_tRP, m_tBurst;
+    double m_cpu_per_access;    // 两次cache访问之间的CPU周期数
+    double m_cpu_per_dram;      // CPU:DRAM时钟比
+
+    UINT32 m_ch_num;
+    UINT32 m_banks_per_ch;
+    INT64* m_open_row;          // 各bank当前打开的行, -1表示已预充电
+    UINT64* m_bank_ready;       // 各bank可以接受下一条命令的时间
+    UINT64* m_bus_ready;        // 各channel数据总线空闲的时间
+    UINT64* m_ctrl_time;        // 各channel控制器可以发射下一个请求的时间
+    std::vector<DRAMReq>* m_queues;
+
+    UINT64 m_row_hits;
+    UINT64 m_row_misses;        // bank已预充电, 只需激活
+    UINT64 m_row_conflicts;     // bank打开了其它行, 需预充电再激活
+    UINT64 m_total_latency;
+    UINT64 m_stall;             // 队列满导致的处理器停顿 (DRAM周期), 加到之后所有请求的到达时间上
+
+    UINT32 getField(UINT32 mem_addr, UINT32 field)
+    {
+        return (UINT32)(((UINT64)mem_addr >> m_shift[field]) & ((1ull << m_bits[field]) - 1));
+    }
+
+    // The mapping string lists the fields from MSB to LSB, false if it is malformed
+    bool parseMapping(const std::string& mapping)
+    {
+        static const char* names[FIELD_NUM] = { "ro", "ra", "ba", "ch", "co" };
+        UINT32 order[FIELD_NUM];
+        bool seen[FIELD_NUM] = { false };
+        if (mapping.size() != FIELD_NUM * 3 - 1) return false;
+        for (UINT32 num = 0; num < FIELD_NUM; num++)
+        {
+            size_t pos = num * 3;
+            if (num > 0 && mapping[pos - 1] != ':') return false;
+            UINT32 f = 0;
+            while (f < FIELD_NUM && mapping.compare(pos, 2, names[f]) != 0) f++;
+            if (f == FIELD_NUM || seen[f]) return false;
+            seen[f] = true;
+            order[num] = f;
+        }
+
+        UINT32 shift = 0;
+        for (INT32 i = FIELD_NUM - 1; i >= 0; i--)
+        {
+            m_shift[order[i]] = shift;
+            shift += m_bits[order[i]];
+        }
+        return true;
+    }
+
+    // When the controller of ch can issue its next request (the queue must not be empty)
+    UINT64 issueTime(UINT32 ch)
+    {
+        UINT64 first = m_queues[ch].front().arrival;
+        return first > m_ctrl_time[ch] ? first : m_ctrl_time[ch];
+    }
+
+    // FR-FCFS among the requests arrived by the issue time: the oldest row hit, otherwise the oldest
+    void issue(UINT32 ch)
+    {
+        std::vector<DRAMReq>& q = m_queues[ch];
+        UINT64 now = issueTime(ch);
+        size_t pick = 0;
+        for (size_t i = 0; i < q.size() && q[i].arrival <= now; i++)
+        {
+            if (m_open_row[ch * m_banks_per_ch + q[i].bank] == (INT64)q[i].row)
+            {
+                pick = i;
+                break;
+            }
+        }
+        DRAMReq req = q[pick];
+        q.erase(q.begin() + pick);
+
+        UINT32 b = ch * m_banks_per_ch + req.bank;
+        UINT64 start = now > m_bank_ready[b] ? now : m_bank_ready[b];
+        UINT64 lat;
+        if (m_open_row[b] == (INT64)req.row)
+        {
+            m_row_hits++;
+            lat = m_tCL;
+        }
+        else if (m_open_row[b] < 0)
+        {
+            m_row_misses++;
+            lat = m_tRCD + m_tCL;
+        }
+        else
+        {
+            m_row_conflicts++;
+            lat = m_tRP + m_tRCD + m_tCL;
+        }
+
+        // 列命令之间只需间隔一个burst, 因此连续的行命中可以流水
+        UINT64 cas = start + lat - m_tCL;
+        UINT64 data = cas + m_tCL > m_bus_ready[ch] ? cas + m_tCL : m_bus_ready[ch];
+        UINT64 done = data + m_tBurst;
+        m_bus_ready[ch] = done;
+        // 控制器最多超前数据总线一个最坏情况 (行冲突) 的延迟, 不同bank的请求仍可重叠
+        UINT64 window = m_tRP + m_tRCD + m_tCL;
+        m_ctrl_time[ch] = done > now + 1 + window ? done - window : now + 1;
+        m_bank_ready[b] = cas + m_tBurst;
+        m_open_row[b] = req.row;
+        m_total_latency += done - req.arrival;
+
+        // Closed-page: precharge right away unless a queued request still wants this row
+        if (!m_open_page)
+        {
+            bool pending = false;
+            for (size_t i = 0; i < q.size() && !pending; i++)
+                pending = (q[i].bank == req.bank && q[i].row == req.row);
+            if (!pending)
+            {
+                m_open_row[b] = -1;
+                m_bank_ready[b] = cas + m_tBurst + m_tRP;
+            }
+        }
+    }
+};
+
+/**************************************
+ * Cache Model Base Class
+**************************************/
+class CacheModel
+{
+public:
+    // Constructor
+    CacheModel(UINT32 block_num, UINT32 log_block_size)
+        : m_block_num(block_num), m_blksz_log(log_block_size),
+          m_rd_reqs(0), m_wr_reqs(0), m_rd_hits(0), m_wr_hits(0), m_dram(NULL)
+    {
+        m_valids = new bool[m_block_num];
+        m_tags = new UINT32[m_block_num];
+        m_replace_q = new UINT32[m_block_num];
+
+        for (UINT32 i = 0; i < m_block_num; i++)
+        {
+            m_valids[i] = false;
+            m_replace_q[i] = i;
+        }
+    }
+
+    // Destructor
+    virtual ~CacheModel()
+    {
+        delete[] m_valids;
+        delete[] m_tags;
+        delete[] m_replace_q;
+    }
+
+    // Update the cache state whenever data is read
+    void readReq(UINT32 mem_addr)
+    {
+        m_rd_reqs++;
+        if (access(mem_addr)) m_rd_hits++;
+        else if (m_dram) m_dram->request(mem_addr, false, m_rd_reqs + m_wr_reqs);
+    }
+
+    // Update the cache state whenever data is written
+    void writeReq(UINT32 mem_addr)
+    {
+        m_wr_reqs++;
+        if (access(mem_addr)) m_wr_hits++;
+        else if (m_dram) m_dram->request(mem_addr, true, m_rd_reqs + m_wr_reqs);
+    }
+
+    // Credit accesses known to hit without looking them up (see the same-line filter)
+    void creditHits(UINT64 rd_hits, UINT64 wr_hits)
+    {
+        m_rd_reqs += rd_hits;
+        m_rd_hits += rd_hits;
+        m_wr_reqs += wr_hits;
+        m_wr_hits += wr_hits;
+    }
+
+    UINT32 getBlockSizeLog() { return m_blksz_log; }
+
+    // Send misses of this cache to a DRAM model (i.e. make it the last level)
+    void setBackend(DRAMModel* dram) { m_dram = dram; }
+
+    UINT64 getRdReq() { return m_rd_reqs; }
+    UINT64 getWrReq() { return m_wr_reqs; }
+    UINT64 getRdHits() { return m_rd_hits; }
+    UINT64 getWrHits() { return m_wr_hits; }
+    UINT64 getMisses() { return (m_rd_reqs - m_rd_hits) + (m_wr_reqs - m_wr_hits); }
+
+    // 子类可以在后面追加自己的统计 (如SectorCache)
+    virtual void dumpResults()
+    {
+        float rdHitRate = m_rd_reqs ? 100 * (float)m_rd_hits/m_rd_reqs : 0;
+        float wrHitRate = m_wr_reqs ? 100 * (float)m_wr_hits/m_wr_reqs : 0;
+        printf("\tread req: %lu,\thit: %lu,\thit rate: %.2f%%\n", m_rd_reqs, m_rd_hits, rdHitRate);
+        printf("\twrite req: %lu,\thit: %lu,\thit rate: %.2f%%\n", m_wr_reqs, m_wr_hits, wrHitRate);
+    }
+
+protected:
+    UINT32 m_block_num;     // The number of cache blocks
+    UINT32 m_blksz_log;     // 块大小的对数
+
+    bool* m_valids;
+    UINT32* m_tags;
+    UINT32* m_replace_q;    // Cache块替换的候选队列
+
+    UINT64 m_rd_reqs;       // The number of read-requests
+    UINT64 m_wr_reqs;       // The number of write-requests
+    UINT64 m_rd_hits;       // The number of hit read-requests
+    UINT64 m_wr_hits;       // The number of hit write-requests
+
+    DRAMModel* m_dram;      // 缺失请求的去向, NULL表示不模拟主存
+
+    // Look up the cache to decide whether the access is hit or missed
+    virtual bool lookup(UINT32 mem_addr, UINT32& blk_id) = 0;
+
+    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    virtual bool access(UINT32 mem_addr) = 0;
+
+    // Update m_replace_q
+    virtual void updateReplaceQ(UINT32 blk_id) = 0;
+};
+
+/**************************************
+ * Fully Associative Cache Class
+**************************************/
+class FullAssoCache : public CacheModel
+{
+public:
+    // Constructor
+    FullAssoCache(UINT32 block_num, UINT32 log_block_size)
+        : CacheModel(block_num, log_block_size) {
+        }
+
+    // Destructor
+    ~FullAssoCache() {}
+
+private:
+    UINT32 getTag(UINT32 addr) { 
+        return (addr >> m_blksz_log);
+        /* TODO */ }
+
+    
+
+    // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        UINT32 tag = getTag(mem_addr);
+        // TODO
+        for(UINT32 i =0; i < m_block_num; i++){
+            if(m_tags[i] == tag){
+                blk_id = i;
+                if(m_valids[i]){
+                    return true;
+                }
+                else{
+                    return false;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    bool access(UINT32 mem_addr)
+    {
+        UINT32 blk_id;
+        if (lookup(mem_addr, blk_id))
+        {
+            updateReplaceQ(blk_id);     // Update m_replace_q
+            return true;
+        }
+
+        // Get the to-be-replaced block id using m_replace_q
+        UINT32 bid_2be_replaced = m_replace_q[0];
+        // TODO
+
+        // Replace the cache block
+        // TODO
+        m_tags[bid_2be_replaced] = getTag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+
+        return false;
+    }
+
+    // Update m_replace_q
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        // TODO
+        for(UINT32 i =0; i < m_block_num; i++){
+            if(m_replace_q[i] == blk_id){
+                for(UINT32 j = i + 1; j < m_block_num; j++){
+                    m_replace_q[j-1] = m_replace_q[j];
+                }
+                m_replace_q[m_block_num-1] = blk_id;
+                break;
+            }
+        }
+    }
+};
+
+/**************************************
+ * Set-Associative Cache Class
+**************************************/
+class SetAssoCache : public CacheModel
+{
+public:
+    // Constructor
+    SetAssoCache(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
+        this->set_block_size = set_block_size;
+        this->set_num_log = set_num_log;
+    }
+
+    // Destructor
+    ~SetAssoCache() {}
+
+private:
+
+    // 
+    UINT32 set_num_log;
+    UINT32 set_block_size;
+
+    //tag
+    UINT32 get_tag(UINT32 mem_addr){
+        return mem_addr >> (set_num_log + PAGE_SIZE_LOG);
+    }
+
+    UINT32 get_set_num(UINT32 mem_addr){
+        return ((mem_addr << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
+    }
+
+    // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        // TODO
+        UINT32 tag =  get_tag(mem_addr);
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 Start  = set_num * set_block_size;
+        for(UINT32 i = 0; i < set_block_size; i++)
+        {
+            blk_id = Start + i;
+            if(m_tags[Start + i] == tag){
+                
+                if(m_valids[Start + i] == true){
+                    return true;
+                }
+                else{
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    bool access(UINT32 mem_addr)
+    {
+        // TODO
+        UINT32 blk_id;
+        if(lookup(mem_addr, blk_id)){
+            updateReplaceQ(blk_id);
+            return true;
+        }
+
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
+        m_tags[bid_2be_replaced] = get_tag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+        return false;
+    }
+
+    // Update m_replace_q
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        // TODO
+        UINT32 set_num = blk_id / set_block_size;
+        UINT32 Start = set_num * set_block_size;
+        for(UINT32 i =0 ;i < set_block_size; i++){
+            if(m_replace_q[Start + i] == blk_id){
+                for(UINT32 j = i + 1; j < set_block_size; j++){
+                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
+                }
+                m_replace_q[Start + set_block_size - 1] = blk_id;
+                break;
+            }
+        } 
+    }
+};
+
+/**************************************
+ * Set-Associative Cache Class (VIVT)
+**************************************/
+class SetAssoCache_VIVT : public CacheModel
+{
+public:
+    // Constructor
+    SetAssoCache_VIVT(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
+        this->set_block_size = set_block_size;
+        this->set_num_log = set_num_log;
+    }
+
+    // Destructor
+    ~SetAssoCache_VIVT() {}
+
+private:
+
+    // Add your members
+    UINT32 set_num_log;
+    UINT32 set_block_size;
+    // Look up the cache to decide whether the access is hit or missed
+
+     //tag
+    UINT32 get_tag(UINT32 mem_addr){
+        return mem_addr >> (set_num_log + PAGE_SIZE_LOG);
+    }
+
+    UINT32 get_set_num(UINT32 mem_addr){
+        return ((mem_addr << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
+    }
+
+
+   // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        // TODO
+        UINT32 tag =  get_tag(mem_addr);
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 Start  = set_num * set_block_size;
+        for(UINT32 i = 0; i < set_block_size; i++){
+            blk_id = Start + i;
+            if(m_tags[Start + i] == tag){
+                
+                if(m_valids[Start + i] == true){
+                    return true;
+                }
+                else{
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    bool access(UINT32 mem_addr)
+    {
+        // TODO
+        UINT32 blk_id;
+        if(lookup(mem_addr, blk_id)){
+            updateReplaceQ(blk_id);
+            return true;
+        }
+
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
+        m_tags[bid_2be_replaced] = get_tag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+        return false;
+    }
+
+    // Update m_replace_q
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        // TODO
+        UINT32 set_num = blk_id / set_block_size;
+        UINT32 Start = set_num * set_block_size;
+        for(UINT32 i =0 ;i < set_block_size; i++){
+            if(m_replace_q[Start + i] == blk_id){
+                for(UINT32 j = i + 1; j < set_block_size; j++){
+                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
+                }
+                m_replace_q[Start + set_block_size - 1] = blk_id;
+                break;
+            }
+        } 
+    }
+};
+
+/**************************************
+ * Set-Associative Cache Class (PIPT)
+**************************************/
+class SetAssoCache_PIPT : public CacheModel
+{
+public:
+    // Constructor
+    SetAssoCache_PIPT(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
+        this->set_block_size = set_block_size;
+        this->set_num_log = set_num_log;
+    }
+
+    // Destructor
+    ~SetAssoCache_PIPT() {}
+
+private:
+
+    // Add your members
+    UINT32 set_num_log;
+    UINT32 set_block_size;
+
+     //tag
+    //tag
+    UINT32 get_tag(UINT32 mem_addr){
+        return get_phy_addr(mem_addr) >> (set_num_log + PAGE_SIZE_LOG);
+    }
+
+    UINT32 get_set_num(UINT32 mem_addr){
+        return ((get_phy_addr(mem_addr) << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
+    }
+    // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        // TODO
+        UINT32 tag =  get_tag(mem_addr);
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 Start  = set_num * set_block_size;
+        for(UINT32 i = 0; i < set_block_size; i++){
+            blk_id = Start + i;
+            if(m_tags[Start + i] == tag){
+                
+                if(m_valids[Start + i] == true){
+                    return true;
+                }
+                else{
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    bool access(UINT32 mem_addr)
+    {
+        // TODO
+        UINT32 blk_id;
+        if(lookup(mem_addr, blk_id)){
+            updateReplaceQ(blk_id);
+            return true;
+        }
+
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
+        m_tags[bid_2be_replaced] = get_tag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+        return false;
+    }
+
+    // Update m_replace_q
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        // TODO
+        UINT32 set_num = blk_id / set_block_size;
+        UINT32 Start = set_num * set_block_size;
+        for(UINT32 i =0 ;i < set_block_size; i++){
+            if(m_replace_q[Start + i] == blk_id){
+                for(UINT32 j = i + 1; j < set_block_size; j++){
+                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
+                }
+                m_replace_q[Start + set_block_size - 1] = blk_id;
+                break;
+            }
+        } 
+    }
+};
+
+/**************************************
+ * Set-Associative Cache Class (VIPT)
+**************************************/
+class SetAssoCache_VIPT : public CacheModel
+{
+public:
+     // Constructor
+    SetAssoCache_VIPT(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size) : CacheModel(pow((double)2, (double) set_num_log) * set_block_size, log_block_size) {
+        this->set_block_size = set_block_size;
+        this->set_num_log = set_num_log;
+    }
+
+    // Destructor
+    ~SetAssoCache_VIPT() {}
+
+private:
+
+    // Add your members
+    UINT32 set_num_log;
+    UINT32 set_block_size;
+
+    //tag
+    UINT32 get_tag(UINT32 mem_addr){
+        return get_phy_addr(mem_addr) >> (set_num_log + PAGE_SIZE_LOG);
+    }
+
+    UINT32 get_set_num(UINT32 mem_addr){
+        return ((mem_addr << (32 - set_num_log - PAGE_SIZE_LOG)) >> (32 - set_num_log));
+    }
+
+     // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        // TODO
+        UINT32 tag =  get_tag(mem_addr);
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 Start  = set_num * set_block_size;
+        for(UINT32 i = 0; i < set_block_size; i++){
+            blk_id = Start + i;
+            if(m_tags[Start + i] == tag){
+                
+                if(m_valids[Start + i] == true){
+                    return true;
+                }
+                else{
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Access the cache: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    bool access(UINT32 mem_addr)
+    {
+        // TODO
+        UINT32 blk_id;
+        if(lookup(mem_addr, blk_id)){
+            updateReplaceQ(blk_id);
+            return true;
+        }
+
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 bid_2be_replaced = m_replace_q[set_num * set_block_size];
+        m_tags[bid_2be_replaced] = get_tag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+        return false;
+    }
+
+    // Update m_replace_q
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        // TODO
+        UINT32 set_num = blk_id / set_block_size;
+        UINT32 Start = set_num * set_block_size;
+        for(UINT32 i =0 ;i < set_block_size; i++){
+            if(m_replace_q[Start + i] == blk_id){
+                for(UINT32 j = i + 1; j < set_block_size; j++){
+                    m_replace_q[Start + j -1 ] = m_replace_q[Start + j ];
+                }
+                m_replace_q[Start + set_block_size - 1] = blk_id;
+                break;
+            }
+        } 
+    }
+};
+
+/**************************************
+ * Set Index Functions
+**************************************/
+// 把块地址 (mem_addr >> m_blksz_log) 映射为组号
+// way只对skewed cache有意义: 每一路都有自己的哈希函数
+class IndexFunc
+{
+public:
+    IndexFunc(UINT32 set_num_log) : m_set_num_log(set_num_log) {}
+    virtual ~IndexFunc() {}
+
+    virtual UINT32 index(UINT32 blk_addr, UINT32 way) = 0;
+
+protected:
+    UINT32 m_set_num_log;
+
+    UINT32 setMask() { return (1u << m_set_num_log) - 1; }
+
+    // Rotate the low m_set_num_log bits of val left by n (只有一组时原样返回)
+    UINT32 rotate(UINT32 val, UINT32 n)
+    {
+        if (m_set_num_log == 0) return val;
+        n %= m_set_num_log;
+        if (n == 0) return val;
+        return ((val << n) | (val >> (m_set_num_log - n))) & setMask();
+    }
+};
+
+// 常规的位切片映射, 作为比较基准
+class BitSliceIndex : public IndexFunc
+{
+public:
+    BitSliceIndex(UINT32 set_num_log) : IndexFunc(set_num_log) {}
+
+    UINT32 index(UINT32 blk_addr, UINT32) { return blk_addr & setMask(); }
+};
+
+// 把块地址按m_set_num_log位分段后全部异或折叠
+class XorFoldIndex : public IndexFunc
+{
+public:
+    XorFoldIndex(UINT32 set_num_log) : IndexFunc(set_num_log) {}
+
+    UINT32 index(UINT32 blk_addr, UINT32)
+    {
+        if (m_set_num_log == 0) return 0;       // 移位0位时下面的循环不会结束
+        UINT32 idx = 0;
+        for (; blk_addr; blk_addr >>= m_set_num_log)
+            idx ^= blk_addr & setMask();
+        return idx;
+    }
+};
+
+// Skewing functions: 第way路使用 A1 ^ rot(A2, way) ^ rot(A3, 2*way + 1),
+// A1/A2/A3为块地址从低到高的三段, 不同路上冲突的两个块很少在其它路上再次冲突
+class SkewedIndex : public IndexFunc
+{
+public:
+    // 只有一组时各路无法错开, 拒绝
+    SkewedIndex(UINT32 set_num_log) : IndexFunc(set_num_log)
+    {
+        if (set_num_log == 0)
+        {
+            fprintf(stderr, "skewed index: a single set cannot be skewed, use at least 2 sets\n");
+            exit(1);
+        }
+    }
+
+    UINT32 index(UINT32 blk_addr, UINT32 way)
+    {
+        UINT32 a1 = blk_addr & setMask();
+        UINT32 a2 = (blk_addr >> m_set_num_log) & setMask();
+        UINT32 a3 = (blk_addr >> (2 * m_set_num_log)) & setMask();
+        return a1 ^ rotate(a2, way) ^ rotate(a3, 2 * way + 1);
+    }
+};
+
+// 多slice LLC的哈希: 第k个slice选择位是 (blk_addr & masks[k]) 的奇偶校验,
+// slice内部的组号仍用低位切片, 组号 = slice号 ## slice内组号
+class SliceHashIndex : public IndexFunc
+{
+public:
+    // param:   set_num_log:    总组数的对数
+    //          masks:          每个slice选择位对应的地址掩码, 共slice_bits个
+    SliceHashIndex(UINT32 set_num_log, const UINT32* masks, UINT32 slice_bits)
+        : IndexFunc(set_num_log), m_slice_bits(slice_bits)
+    {
+        assert(slice_bits <= set_num_log);
+        m_masks = new UINT32[slice_bits];
+        for (UINT32 i = 0; i < slice_bits; i++)
+            m_masks[i] = masks[i];
+    }
+
+    ~SliceHashIndex() { delete[] m_masks; }
+
+    UINT32 index(UINT32 blk_addr, UINT32)
+    {
+        UINT32 slice = 0;
+        for (UINT32 i = 0; i < m_slice_bits; i++)
+            slice |= (UINT32)__builtin_parity(blk_addr & m_masks[i]) << i;
+
+        UINT32 local_log = m_set_num_log - m_slice_bits;
+        return (slice << local_log) | (blk_addr & ((1u << local_log) - 1));
+    }
+
+private:
+    UINT32 m_slice_bits;
+    UINT32* m_masks;
+};
+
+/**************************************
+ * Utility Monitor (UMON)
+**************************************/
+// 一个owner的影子标签目录: 只在采样组 (组号低sample_log位为0) 上模拟一个独占全部路的
+// LRU cache, 统计命中在LRU栈各位置上的次数, 由此得到该owner分到w路时的缺失数曲线.
+class UtilityMonitor
+{
+public:
+    UtilityMonitor(UINT32 set_num_log, UINT32 way_num, UINT32 sample_log)
+        : m_way_num(way_num), m_sample_log(sample_log < set_num_log ? sample_log : set_num_log), m_accesses(0)
+    {
+        m_stacks.resize(1u << (set_num_log - m_sample_log));
+        m_pos_hits.assign(way_num, 0);
+    }
+
+    // Feed an access of this owner; only sampled sets are simulated
+    void access(UINT32 set_num, UINT32 tag)
+    {
+        if (set_num & ((1u << m_sample_log) - 1)) return;
+        m_accesses++;
+
+        std::vector<UINT32>& stack = m_stacks[set_num >> m_sample_log];     // stack[0]为MRU
+        std::vector<UINT32>::iterator it = std::find(stack.begin(), stack.end(), tag);
+        if (it != stack.end())
+        {
+            m_pos_hits[it - stack.begin()]++;
+            stack.erase(it);
+        }
+        else if (stack.size() == m_way_num)
+            stack.pop_back();
+        stack.insert(stack.begin(), tag);
+    }
+
+    // Estimated misses (over the whole cache) if this owner had `ways` ways
+    double getMisses(UINT32 ways)
+    {
+        UINT64 misses = m_accesses;
+        for (UINT32 p = 0; p < ways && p < m_way_num; p++)
+            misses -= m_pos_hits[p];
+        return (double)misses * (1u << m_sample_log);
+    }
+
+private:
+    UINT32 m_way_num;
+    UINT32 m_sample_log;
+    UINT64 m_accesses;                          // 采样组上的访问数
+    std::vector<std::vector<UINT32> > m_stacks; // 每个采样组的LRU栈
+    std::vector<UINT64> m_pos_hits;             // 命中在LRU栈第p个位置的次数
+};
+
+/**************************************
+ * Set-Associative Cache Class (pluggable index function)
+**************************************/
+// 组号由IndexFunc决定, 因此tag保存完整的块地址.
+// 支持按owner划分路 (类似Intel CAT): owner的缺失只能填入其掩码内的路, 命中不受限制.
+// 路掩码为64位, 因此相联度最多为64.
+// 可选地为每个owner挂一个UMON, 并用UCP的lookahead算法求出建议的划分.
+class SetAssoCache_Hashed : public CacheModel
+{
+public:
+    // Constructor
+    // param:   index_func:     组号映射函数, 由本对象负责释放
+    SetAssoCache_Hashed(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size, IndexFunc* index_func)
+        : CacheModel((1u << set_num_log) * set_block_size, log_block_size),
+          m_set_num_log(set_num_log), m_set_block_size(set_block_size), m_index(index_func)
+    {
+        if (set_block_size == 0 || set_block_size > 64)
+        {
+            fprintf(stderr, "set-associative cache: associativity %u is not in [1, 64]\n", set_block_size);
+            exit(1);
+        }
+        setOwnerNum(1);
+    }
+
+    // Destructor
+    ~SetAssoCache_Hashed()
+    {
+        delete m_index;
+        for (size_t i = 0; i < m_umons.size(); i++)
+            delete m_umons[i];
+    }
+
+    // Set the number of owners (threads/processes sharing the cache); every owner may use all ways
+    void setOwnerNum(UINT32 owner_num)
+    {
+        if (owner_num == 0) owner_num = 1;
+        m_way_masks.assign(owner_num, allWays());
+        m_owner_reqs.assign(owner_num, 0);
+        m_owner_hits.assign(owner_num, 0);
+    }
+
+    // Restrict the fills of owner to the ways in mask (bit i: way i)
+    void setWayMask(UINT32 owner, UINT64 mask)
+    {
+        if (owner < m_way_masks.size() && (mask & allWays()))
+            m_way_masks[owner] = mask;
+    }
+
+    // Requests on behalf of an owner (taken modulo the number of owners); the one-argument
+    // readReq/writeReq of CacheModel are requests of owner 0
+    using CacheModel::readReq;
+    using CacheModel::writeReq;
+
+    void readReq(UINT32 mem_addr, UINT32 owner)
+    {
+        m_rd_reqs++;
+        if (accessBy(mem_addr, owner % m_way_masks.size())) m_rd_hits++;
+        else if (m_dram) m_dram->request(mem_addr, false, m_rd_reqs + m_wr_reqs);
+    }
+
+    void writeReq(UINT32 mem_addr, UINT32 owner)
+    {
+        m_wr_reqs++;
+        if (accessBy(mem_addr, owner % m_way_masks.size())) m_wr_hits++;
+        else if (m_dram) m_dram->request(mem_addr, true, m_rd_reqs + m_wr_reqs);
+    }
+
+    // Per-owner part of creditHits: count hits of owner that skipped the model
+    void creditOwnerHits(UINT32 owner, UINT64 hits)
+    {
+        owner %= m_way_masks.size();
+        m_owner_reqs[owner] += hits;
+        m_owner_hits[owner] += hits;
+    }
+
+    // Attach a utility monitor sampling one set out of 2^sample_log to every owner
+    void enableUMON(UINT32 sample_log)
+    {
+        for (size_t i = m_umons.size(); i < m_way_masks.size(); i++)
+            m_umons.push_back(new UtilityMonitor(m_set_num_log, m_set_block_size, sample_log));
+    }
+
+    // UCP lookahead: every owner gets at least one way, then the remaining ways go one
+    // batch at a time to the owner with the highest marginal utility (misses saved per way)
+    std::vector<UINT32> getUCPPartition()
+    {
+        UINT32 owner_num = m_umons.size();
+        std::vector<UINT32> alloc(owner_num, 1);
+        INT32 balance = (INT32)m_set_block_size - (INT32)owner_num;
+
+        while (balance > 0)
+        {
+            double best_mu = -1;
+            UINT32 best_owner = 0, best_k = 1;
+            for (UINT32 o = 0; o < owner_num; o++)
+            {
+                double base = m_umons[o]->getMisses(alloc[o]);
+                for (UINT32 k = 1; k <= (UINT32)balance; k++)
+                {
+                    double mu = (base - m_umons[o]->getMisses(alloc[o] + k)) / k;
+                    if (mu > best_mu)
+                    {
+                        best_mu = mu;
+                        best_owner = o;
+                        best_k = k;
+                    }
+                }
+            }
+            alloc[best_owner] += best_k;
+            balance -= best_k;
+        }
+        return alloc;
+    }
+
+    void dumpPartition()
+    {
+        for (UINT32 o = 0; o < m_way_masks.size(); o++)
+        {
+            if (m_owner_reqs[o] == 0) continue;
+            printf("\towner %u:\tmask: 0x%lx,\treq: %lu,\thit rate: %.2f%%\n", o, m_way_masks[o],
+                   m_owner_reqs[o], 100.0 * m_owner_hits[o] / m_owner_reqs[o]);
+        }
+        if (m_umons.empty() || m_umons.size() > m_set_block_size) return;
+
+        for (UINT32 o = 0; o < m_umons.size(); o++)
+        {
+            if (m_owner_reqs[o] == 0) continue;
+            printf("\towner %u estimated misses by ways:", o);
+            for (UINT32 w = 1; w <= m_set_block_size; w++)
+                printf(" %.0f", m_umons[o]->getMisses(w));
+            printf("\n");
+        }
+
+        // 按分配结果给出连续的CAT掩码
+        std::vector<UINT32> alloc = getUCPPartition();
+        printf("\tUCP partition:");
+        for (UINT32 o = 0, low = 0; o < alloc.size(); low += alloc[o], o++)
+            printf(" owner %u: %u ways (0x%lx)%s", o, alloc[o], (alloc[o] >= 64 ? ~0ul : (1ul << alloc[o]) - 1) << low,
+                   o + 1 < alloc.size() ? "," : "\n");
+    }
+
+private:
+    UINT32 m_set_num_log;
+    UINT32 m_set_block_size;
+    IndexFunc* m_index;
+
+    std::vector<UINT64> m_way_masks;        // 每个owner可以填入的路
+    std::vector<UINT64> m_owner_reqs;
+    std::vector<UINT64> m_owner_hits;
+    std::vector<UtilityMonitor*> m_umons;
+
+    UINT64 allWays() { return m_set_block_size >= 64 ? ~0ul : (1ul << m_set_block_size) - 1; }
+
+    UINT32 get_tag(UINT32 mem_addr) { return mem_addr >> m_blksz_log; }
+
+    UINT32 get_set_num(UINT32 mem_addr) { return m_index->index(mem_addr >> m_blksz_log, 0); }
+
+    // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        UINT32 tag = get_tag(mem_addr);
+        UINT32 start = get_set_num(mem_addr) * m_set_block_size;
+        for (UINT32 i = 0; i < m_set_block_size; i++)
+        {
+            if (m_valids[start + i] && m_tags[start + i] == tag)
+            {
+                blk_id = start + i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool access(UINT32 mem_addr) { return accessBy(mem_addr, 0); }
+
+    // Access the cache for owner: update m_replace_q if hit, otherwise replace a block and update m_replace_q
+    bool accessBy(UINT32 mem_addr, UINT32 owner)
+    {
+        UINT32 set_num = get_set_num(mem_addr);
+        if (!m_umons.empty())
+            m_umons[owner]->access(set_num, get_tag(mem_addr));
+        m_owner_reqs[owner]++;
+
+        UINT32 blk_id;
+        if (lookup(mem_addr, blk_id))
+        {
+            updateReplaceQ(blk_id);
+            m_owner_hits[owner]++;
+            return true;
+        }
+
+        // 替换队列中第一个位于owner掩码内的块
+        UINT32 start = set_num * m_set_block_size;
+        UINT32 bid_2be_replaced = m_replace_q[start];
+        for (UINT32 i = 0; i < m_set_block_size; i++)
+        {
+            if (m_way_masks[owner] & (1ul << (m_replace_q[start + i] - start)))
+            {
+                bid_2be_replaced = m_replace_q[start + i];
+                break;
+            }
+        }
+
+        m_tags[bid_2be_replaced] = get_tag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+        return false;
+    }
+
+    // Update m_replace_q (LRU inside the set)
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        UINT32 start = blk_id / m_set_block_size * m_set_block_size;
+        for (UINT32 i = 0; i < m_set_block_size; i++)
+        {
+            if (m_replace_q[start + i] == blk_id)
+            {
+                for (UINT32 j = i + 1; j < m_set_block_size; j++)
+                    m_replace_q[start + j - 1] = m_replace_q[start + j];
+                m_replace_q[start + m_set_block_size - 1] = blk_id;
+                break;
+            }
+        }
+    }
+};
+
+/**************************************
+ * Skewed-Associative Cache Class
+**************************************/
+// 每一路用不同的哈希函数选组, 同一个"组"在不同路上并不对应, 无法维护组内LRU队列,
+// 因此替换策略改为: 优先无效块, 否则替换候选块中最久未被访问者 (时间戳近似LRU)
+// 块号 = way * 组数 + 组号
+class SkewedAssoCache : public CacheModel
+{
+public:
+    // Constructor
+    // param:   index_func:     每路的组号映射函数, 由本对象负责释放
+    SkewedAssoCache(UINT32 set_num_log, UINT32 way_num, UINT32 log_block_size, IndexFunc* index_func)
+        : CacheModel((1u << set_num_log) * way_num, log_block_size),
+          m_set_num_log(set_num_log), m_way_num(way_num), m_index(index_func), m_clock(0)
+    {
+        m_stamps = new UINT64[m_block_num];
+        for (UINT32 i = 0; i < m_block_num; i++)
+            m_stamps[i] = 0;
+    }
+
+    // Destructor
+    ~SkewedAssoCache()
+    {
+        delete m_index;
+        delete[] m_stamps;
+    }
+
+private:
+    UINT32 m_set_num_log;
+    UINT32 m_way_num;
+    IndexFunc* m_index;
+    UINT64* m_stamps;       // 每个块最近一次被访问的时间
+    UINT64 m_clock;
+
+    UINT32 get_tag(UINT32 mem_addr) { return mem_addr >> m_blksz_log; }
+
+    UINT32 get_blk_id(UINT32 mem_addr, UINT32 way)
+    {
+        return (way << m_set_num_log) + m_index->index(mem_addr >> m_blksz_log, way);
+    }
+
+    // Look up the cache to decide whether the access is hit or missed
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        UINT32 tag = get_tag(mem_addr);
+        for (UINT32 w = 0; w < m_way_num; w++)
+        {
+            UINT32 id = get_blk_id(mem_addr, w);
+            if (m_valids[id] && m_tags[id] == tag)
+            {
+                blk_id = id;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Access the cache: refresh the time stamp if hit, otherwise replace the oldest candidate
+    bool access(UINT32 mem_addr)
+    {
+        UINT32 blk_id;
+        if (lookup(mem_addr, blk_id))
+        {
+            updateReplaceQ(blk_id);
+            return true;
+        }
+
+        UINT32 bid_2be_replaced = get_blk_id(mem_addr, 0);
+        for (UINT32 w = 0; w < m_way_num && m_valids[bid_2be_replaced]; w++)
+        {
+            UINT32 id = get_blk_id(mem_addr, w);
+            if (!m_valids[id] || m_stamps[id] < m_stamps[bid_2be_replaced])
+                bid_2be_replaced = id;
+        }
+
+        m_tags[bid_2be_replaced] = get_tag(mem_addr);
+        m_valids[bid_2be_replaced] = true;
+        updateReplaceQ(bid_2be_replaced);
+        return false;
+    }
+
+    // Update the time stamp of blk_id
+    void updateReplaceQ(UINT32 blk_id) { m_stamps[blk_id] = ++m_clock; }
+};
+
+/**************************************
+ * Belady OPT Cache Class (offline)
+**************************************/
+// 先用record()记录整个访存流, 再调用simulate()离线重放:
+// 反向扫描一遍求出每次访问的下一次使用位置, 正向重放时每组用按下一次使用位置排序的
+// 平衡树维护驻留块, 缺失时替换下一次使用最远的块, 每次访问O(log w).
+// 与LRU模型一样总是分配缺失的块 (不旁路), 组号取块地址低位.
+class BeladyOPTCache : public CacheModel
+{
+public:
+    // param:   max_records:    最多记录的访问次数, 位置用UINT32表示, 因此不超过2^32-1
+    BeladyOPTCache(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size, UINT32 max_records = NEVER)
+        : CacheModel((1u << set_num_log) * set_block_size, log_block_size),
+          m_set_num_log(set_num_log), m_set_block_size(set_block_size), m_max_records(max_records), m_pos(0)
+    {
+        m_sets = new std::set<std::pair<UINT32, UINT32> >[1u << set_num_log];
+    }
+
+    ~BeladyOPTCache() { delete[] m_sets; }
+
+    // Append an access to the recorded stream, return false once the stream is full
+    bool record(UINT32 mem_addr, bool is_write)
+    {
+        if (isFull()) return false;
+        m_stream.push_back(((mem_addr >> m_blksz_log) << 1) | is_write);
+        return true;
+    }
+
+    bool isFull() { return m_stream.size() >= m_max_records; }
+
+    UINT64 getRecorded() { return m_stream.size(); }
+
+    // Replay the recorded stream with optimal replacement, then the stats are ready for dumpResults
+    void simulate()
+    {
+        UINT32 n = m_stream.size();
+        m_next_use.assign(n, (UINT32)NEVER);     // 按值传入, 避免ODR-use
+        std::unordered_map<UINT32, UINT32> seen;
+        for (UINT32 i = n; i-- > 0; )
+        {
+            UINT32 blk = m_stream[i] >> 1;
+            std::unordered_map<UINT32, UINT32>::iterator it = seen.find(blk);
+            if (it != seen.end())
+            {
+                m_next_use[i] = it->second;
+                it->second = i;
+            }
+            else seen[blk] = i;
+        }
+
+        for (m_pos = 0; m_pos < n; m_pos++)
+        {
+            UINT32 mem_addr = (m_stream[m_pos] >> 1) << m_blksz_log;
+            if (m_stream[m_pos] & 1) writeReq(mem_addr);
+            else readReq(mem_addr);
+        }
+
+        std::vector<UINT32>().swap(m_next_use);
+    }
+
+private:
+    static const UINT32 NEVER = 0xffffffffu;   // 不会再被使用
+
+    UINT32 m_set_num_log;
+    UINT32 m_set_block_size;
+    UINT32 m_max_records;
+
+    std::vector<UINT32> m_stream;               // 块地址 << 1 | 是否写
+    std::vector<UINT32> m_next_use;             // 每次访问的下一次使用位置
+    UINT32 m_pos;                               // 当前重放到的位置
+
+    std::unordered_map<UINT32, UINT32> m_resident;          // 驻留块 -> 下一次使用位置
+    std::set<std::pair<UINT32, UINT32> >* m_sets;           // 每组的 (下一次使用位置, 块地址)
+
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        blk_id = mem_addr >> m_blksz_log;
+        return m_resident.count(blk_id) != 0;
+    }
+
+    // Access the cache at the current replay position
+    bool access(UINT32 mem_addr)
+    {
+        UINT32 blk;
+        bool hit = lookup(mem_addr, blk);
+        std::set<std::pair<UINT32, UINT32> >& set = m_sets[blk & ((1u << m_set_num_log) - 1)];
+        UINT32 next = m_next_use[m_pos];
+
+        if (hit)
+        {
+            set.erase(std::make_pair(m_resident[blk], blk));
+        }
+        else if (set.size() == m_set_block_size)
+        {
+            std::set<std::pair<UINT32, UINT32> >::iterator victim = --set.end();
+            m_resident.erase(victim->second);
+            set.erase(victim);
+        }
+
+        set.insert(std::make_pair(next, blk));
+        m_resident[blk] = next;
+        return hit;
+    }
+
+    void updateReplaceQ(UINT32) {}
+};
+
+/**************************************
+ * StatCache Sampler
+**************************************/
+// 稀疏重用距离采样: 平均每sample_period次访问随机选一次访问, 监视它访问的行,
+// 直到该行再次被访问, 两次访问之间的访问次数即一个重用距离样本; 到结束时仍未被
+// 重用的样本为悬空样本 (视为必然缺失).
+// 由样本可以求解任意容量的缺失率:
+//      随机替换 (StatCache): 解不动点方程 m = 1/N * sum(1 - (1 - 1/L)^(rd_i * m))
+//      LRU (StatStack):      重用距离d对应的期望栈距离 sd(d) = 1/N * sum(min(rd_i, d)),
+//                            sd(rd_i) >= L 的样本缺失
+// 判断是否需要采样/检查监视的快速路径由调用者完成 (见cacheModel.cpp), 本类只处理慢路径.
+class StatCacheSampler
+{
+public:
+    StatCacheSampler(UINT32 sample_period, UINT32 seed = 1)
+        : m_period(sample_period), m_rand(seed ? seed : 1) {}
+
+    // Draw the distance to the next sample (geometric, mean m_period) to avoid aliasing with loops
+    UINT32 nextInterval()
+    {
+        m_rand ^= m_rand << 13;
+        m_rand ^= m_rand >> 7;
+        m_rand ^= m_rand << 17;
+        double u = ((m_rand >> 11) + 1) * (1.0 / 9007199254740993.0);
+        double n = -log(u) * m_period;
+        return n < 1 ? 1 : (n > 0xffffffffu ? 0xffffffffu : (UINT32)n);
+    }
+
+    // Start watching the line touched by the access number now
+    void sample(UINT64 line, UINT64 now)
+    {
+        if (m_watches.count(line) == 0)
+            m_watches[line] = now;
+    }
+
+    // The line was accessed again at access number now; return true if it was being watched
+    bool reuse(UINT64 line, UINT64 now)
+    {
+        std::unordered_map<UINT64, UINT64>::iterator it = m_watches.find(line);
+        if (it == m_watches.end()) return false;
+        m_reuse.push_back(now - it->second - 1);
+        m_watches.erase(it);
+        return true;
+    }
+
+    bool isWatched(UINT64 line) { return m_watches.count(line) != 0; }
+
+    UINT64 getSamples() { return m_reuse.size() + m_watches.size(); }
+    UINT64 getDangling() { return m_watches.size(); }
+
+    // Miss ratio of a random-replacement cache of cache_lines lines
+    double randomMissRatio(UINT64 cache_lines)
+    {
+        UINT64 n = getSamples();
+        if (n == 0) return 0;
+
+        // 右端关于m单调递增, 用二分求 f(m) = m 的不动点
+        double keep = 1.0 - 1.0 / cache_lines;
+        double lo = 0, hi = 1;
+        for (int iter = 0; iter < 50; iter++)
+        {
+            double m = (lo + hi) / 2;
+            double sum = (double)m_watches.size();
+            for (size_t i = 0; i < m_reuse.size(); i++)
+                sum += 1.0 - pow(keep, m_reuse[i] * m);
+            if (sum / n > m) lo = m;
+            else hi = m;
+        }
+        return (lo + hi) / 2;
+    }
+
+    // Miss ratio of an LRU cache of cache_lines lines (fully associative)
+    double lruMissRatio(UINT64 cache_lines)
+    {
+        UINT64 n = getSamples();
+        if (n == 0) return 0;
+        prepareStack();
+
+        // m_sorted升序, 找到第一个期望栈距离 >= cache_lines 的样本, 其后的样本全部缺失
+        UINT64 misses = m_watches.size();
+        size_t lo = 0, hi = m_sorted.size();
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (stackDistance(mid) >= cache_lines) hi = mid;
+            else lo = mid + 1;
+        }
+        misses += m_sorted.size() - lo;
+        return (double)misses / n;
+    }
+
+    // Print the miss-ratio curves for 2^min_log .. 2^max_log lines
+    void dumpResults(UINT32 min_log, UINT32 max_log, UINT32 line_log)
+    {
+        printf("\tsamples: %lu,\tdangling: %lu\n", getSamples(), getDangling());
+        printf("\t%-12s%-16s%-16s\n", "size", "random miss", "LRU miss");
+        for (UINT32 k = min_log; k <= max_log; k++)
+        {
+            UINT64 bytes = 1ull << (k + line_log);
+            char size[32];
+            if (bytes >= (1ull << 20)) snprintf(size, sizeof(size), "%luMB", bytes >> 20);
+            else snprintf(size, sizeof(size), "%luKB", bytes >> 10);
+            printf("\t%-12s%-16.2f%-16.2f\n", size, 100 * randomMissRatio(1ull << k), 100 * lruMissRatio(1ull << k));
+        }
+    }
+
+private:
+    UINT32 m_period;
+    UINT64 m_rand;
+    std::unordered_map<UINT64, UINT64> m_watches;   // 被监视的行 -> 采样时的访问序号
+    std::vector<UINT64> m_reuse;                    // 已完成的重用距离样本
+
+    std::vector<UINT64> m_sorted;                   // 排序后的重用距离
+    std::vector<UINT64> m_prefix;                   // m_sorted的前缀和
+
+    void prepareStack()
+    {
+        if (m_sorted.size() == m_reuse.size()) return;
+        m_sorted = m_reuse;
+        std::sort(m_sorted.begin(), m_sorted.end());
+        m_prefix.assign(m_sorted.size() + 1, 0);
+        for (size_t i = 0; i < m_sorted.size(); i++)
+            m_prefix[i + 1] = m_prefix[i] + m_sorted[i];
+    }
+
+    // Expected stack distance of the i-th smallest reuse distance:
+    // 1/N * sum(min(rd_j, d)), 悬空样本的重用距离视为无穷大
+    double stackDistance(size_t i)
+    {
+        UINT64 d = m_sorted[i];
+        size_t le = std::upper_bound(m_sorted.begin(), m_sorted.end(), d) - m_sorted.begin();
+        double sum = (double)m_prefix[le] + (double)d * (m_sorted.size() - le + m_watches.size());
+        return sum / getSamples();
+    }
+};
+
+/**************************************
+ * Line Compression (BDI / FPC)
+**************************************/
+// 只计算压缩后的大小, 不真正生成压缩数据. 行大小须为8字节的倍数, 主机为小端.
+namespace compress
+{
+    // The i-th k-byte element of the line, sign-extended
+    inline INT64 loadElem(const UINT8* line, UINT32 k, UINT32 i)
+    {
+        UINT64 v = 0;
+        memcpy(&v, line + i * k, k);
+        UINT32 shift = 64 - 8 * k;
+        return (INT64)(v << shift) >> shift;
+    }
+
+    inline bool fitsSigned(INT64 v, UINT32 bytes)
+    {
+        if (bytes >= 8) return true;
+        INT64 lim = 1ll << (8 * bytes - 1);
+        return v >= -lim && v < lim;
+    }
+
+    // Base-Delta-Immediate: 全0行, 重复的8字节值, 或者 (k字节基址, d字节差值) 的各种组合;
+    // 每个元素相对隐含的0基址或者第一个不能用立即数表示的元素作差.
+    // 返回压缩后的字节数, 不可压缩时返回行大小 (元素选择位算作tag开销, 不计入)
+    inline UINT32 bdiSize(const UINT8* line, UINT32 line_size)
+    {
+        static const UINT32 configs[][2] = { {8, 1}, {8, 2}, {8, 4}, {4, 1}, {4, 2}, {2, 1} };
+
+        bool zero = true, repeated = true;
+        for (UINT32 i = 0; i < line_size / 8; i++)
+        {
+            INT64 v = loadElem(line, 8, i);
+            zero &= (v == 0);
+            repeated &= (v == loadElem(line, 8, 0));
+        }
+        if (zero) return 1;
+        if (repeated) return 8;
+
+        UINT32 best = line_size;
+        for (UINT32 c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+        {
+            UINT32 k = configs[c][0], d = configs[c][1], n = line_size / k;
+            if (k + n * d >= best) continue;
+
+            bool has_base = false, ok = true;
+            INT64 base = 0;
+            for (UINT32 i = 0; i < n && ok; i++)
+            {
+                INT64 v = loadElem(line, k, i);
+                if (fitsSigned(v, d)) continue;
+                if (!has_base)
+                {
+                    base = v;
+                    has_base = true;
+                }
+                ok = fitsSigned((INT64)((UINT64)v - (UINT64)base), d);
+            }
+            if (ok) best = k + n * d;
+        }
+        return best;
+    }
+
+    // Frequent Pattern Compression: 每个32位字一个3位前缀加上按模式压缩的数据,
+    // 连续的0字 (最多8个) 合并为一项
+    inline UINT32 fpcSize(const UINT8* line, UINT32 line_size)
+    {
+        UINT32 n = line_size / 4, bits = 0;
+        for (UINT32 i = 0; i < n; )
+        {
+            UINT32 w;
+            memcpy(&w, line + i * 4, 4);
+            INT32 s = (INT32)w;
+            INT32 lo = (INT16)(w & 0xffff), hi = (INT16)(w >> 16);
+            UINT32 b = w & 0xff;
+
+            if (w == 0)
+            {
+                UINT32 run = 1;
+                while (run < 8 && i + run < n && !memcmp(line + (i + run) * 4, "\0\0\0\0", 4))
+                    run++;
+                bits += 3 + 3;
+                i += run;
+                continue;
+            }
+
+            if (s >= -8 && s < 8) bits += 3 + 4;
+            else if (s >= -128 && s < 128) bits += 3 + 8;
+            else if (s >= -32768 && s < 32768) bits += 3 + 16;
+            else if ((w & 0xffff) == 0) bits += 3 + 16;
+            else if (lo >= -128 && lo < 128 && hi >= -128 && hi < 128) bits += 3 + 16;
+            else if (w == b * 0x01010101u) bits += 3 + 8;
+            else bits += 3 + 32;
+            i++;
+        }
+        UINT32 bytes = (bits + 7) / 8;
+        return bytes < line_size ? bytes : line_size;
+    }
+}
+
+/**************************************
+ * Compressed Cache Class
+**************************************/
+// 每组的数据阵列按段 (默认8字节) 分配, 容量与未压缩的set_block_size路相同,
+// tag数是路数的tag_factor倍; 每个块占用ceil(压缩大小/段大小)个段.
+// 每次请求前由setLineSize()给出所访问行当前的压缩大小; 命中时按新的大小调整占用
+// (写入可能使行变大), 空间或tag不足时按LRU依次换出.
+// 组号取块地址低位, 与BitSliceIndex的SetAssoCache_Hashed可直接比较.
+class CompressedCache : public CacheModel
+{
+public:
+    CompressedCache(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_block_size,
+                    UINT32 tag_factor = 2, UINT32 seg_log = 3)
+        : CacheModel((1u << set_num_log) * set_block_size * tag_factor, log_block_size),
+          m_set_num_log(set_num_log), m_set_block_size(set_block_size), m_tag_num(set_block_size * tag_factor),
+          m_seg_log(seg_log), m_line_segs(1u << (log_block_size - seg_log)),
+          m_set_segs(set_block_size << (log_block_size - seg_log)), m_next_segs(1u << (log_block_size - seg_log)),
+          m_resident(0), m_resident_sum(0), m_raw_bytes(0), m_comp_bytes(0)
+    {
+        m_segs = new UINT32[m_block_num];
+        m_set_used = new UINT32[1u << set_num_log];
+        m_set_valid = new UINT32[1u << set_num_log];
+        for (UINT32 i = 0; i < (1u << set_num_log); i++)
+            m_set_used[i] = m_set_valid[i] = 0;
+    }
+
+    ~CompressedCache()
+    {
+        delete[] m_segs;
+        delete[] m_set_used;
+        delete[] m_set_valid;
+    }
+
+    // Give the compressed size in bytes of the line touched by the next request
+    void setLineSize(UINT32 bytes)
+    {
+        m_next_segs = (bytes + (1u << m_seg_log) - 1) >> m_seg_log;
+        if (m_next_segs == 0) m_next_segs = 1;
+        if (m_next_segs > m_line_segs) m_next_segs = m_line_segs;
+        m_raw_bytes += 1u << m_blksz_log;
+        m_comp_bytes += m_next_segs << m_seg_log;
+    }
+
+    // Average number of resident lines relative to the uncompressed capacity
+    double getEffectiveCapacity()
+    {
+        UINT64 reqs = m_rd_reqs + m_wr_reqs;
+        return reqs ? (double)m_resident_sum / reqs / ((1u << m_set_num_log) * m_set_block_size) : 0;
+    }
+
+    void dumpCompression()
+    {
+        printf("\tcompression ratio: %.2f,\teffective capacity: %.2fx\n",
+               m_comp_bytes ? (double)m_raw_bytes / m_comp_bytes : 0, getEffectiveCapacity());
+    }
+
+private:
+    static const UINT32 NONE = 0xffffffffu;
+
+    UINT32 m_set_num_log;
+    UINT32 m_set_block_size;    // 未压缩时的路数
+    UINT32 m_tag_num;           // 每组的tag数
+    UINT32 m_seg_log;
+    UINT32 m_line_segs;         // 未压缩的行占用的段数
+    UINT32 m_set_segs;          // 每组的段数
+    UINT32 m_next_segs;         // 下一次请求的行占用的段数
+
+    UINT32* m_segs;             // 每个块占用的段数
+    UINT32* m_set_used;         // 每组已占用的段数
+    UINT32* m_set_valid;        // 每组的有效块数
+
+    UINT64 m_resident;          // 当前驻留的块数
+    UINT64 m_resident_sum;      // 每次访问时驻留块数之和
+    UINT64 m_raw_bytes;         // 所访问行的未压缩大小之和
+    UINT64 m_comp_bytes;        // 所访问行的压缩大小之和 (按段取整)
+
+    UINT32 get_set_num(UINT32 mem_addr) { return (mem_addr >> m_blksz_log) & ((1u << m_set_num_log) - 1); }
+
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        UINT32 tag = mem_addr >> m_blksz_log;
+        UINT32 start = get_set_num(mem_addr) * m_tag_num;
+        for (UINT32 i = 0; i < m_tag_num; i++)
+        {
+            if (m_valids[start + i] && m_tags[start + i] == tag)
+            {
+                blk_id = start + i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Evict LRU blocks other than keep until need more segments (and a free tag if keep is NONE) fit
+    void makeRoom(UINT32 set_num, UINT32 keep, UINT32 need)
+    {
+        UINT32 start = set_num * m_tag_num;
+        for (UINT32 i = 0; i < m_tag_num; i++)
+        {
+            bool tag_ok = keep != NONE || m_set_valid[set_num] < m_tag_num;
+            if (tag_ok && m_set_used[set_num] + need <= m_set_segs) break;
+
+            UINT32 blk_id = m_replace_q[start + i];
+            if (!m_valids[blk_id] || blk_id == keep) continue;
+            m_valids[blk_id] = false;
+            m_set_used[set_num] -= m_segs[blk_id];
+            m_set_valid[set_num]--;
+            m_resident--;
+        }
+    }
+
+    bool access(UINT32 mem_addr)
+    {
+        UINT32 set_num = get_set_num(mem_addr);
+        UINT32 blk_id;
+        bool hit = lookup(mem_addr, blk_id);
+
+        if (hit)
+        {
+            m_set_used[set_num] = m_set_used[set_num] - m_segs[blk_id] + m_next_segs;
+            m_segs[blk_id] = m_next_segs;
+            makeRoom(set_num, blk_id, 0);
+        }
+        else
+        {
+            makeRoom(set_num, NONE, m_next_segs);
+            UINT32 start = set_num * m_tag_num;
+            for (blk_id = start; m_valids[blk_id]; blk_id++)
+                ;
+            m_tags[blk_id] = mem_addr >> m_blksz_log;
+            m_valids[blk_id] = true;
+            m_segs[blk_id] = m_next_segs;
+            m_set_used[set_num] += m_next_segs;
+            m_set_valid[set_num]++;
+            m_resident++;
+        }
+
+        updateReplaceQ(blk_id);
+        m_resident_sum += m_resident;
+        return hit;
+    }
+
+    // Update m_replace_q (LRU over the tags of the set)
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        UINT32 start = blk_id / m_tag_num * m_tag_num;
+        for (UINT32 i = 0; i < m_tag_num; i++)
+        {
+            if (m_replace_q[start + i] == blk_id)
+            {
+                for (UINT32 j = i + 1; j < m_tag_num; j++)
+                    m_replace_q[start + j - 1] = m_replace_q[start + j];
+                m_replace_q[start + m_tag_num - 1] = blk_id;
+                break;
+            }
+        }
+    }
+};
+
+/**************************************
+ * Sector Cache Class
+**************************************/
+// 每个tag对应一个2^sector_log字节的扇区, 扇区内每个2^sub_log字节的子块有一个有效位.
+// 扇区命中但子块无效时只取回该子块 (子块缺失), 扇区缺失时按组内LRU替换整个扇区.
+// m_blksz_log是子块大小, 因此同行过滤按子块粒度工作.
+class SectorCache : public CacheModel
+{
+public:
+    SectorCache(UINT32 set_num_log, UINT32 set_block_size, UINT32 log_sector_size, UINT32 log_sub_size)
+        : CacheModel((1u << set_num_log) * set_block_size, log_sub_size),
+          m_set_num_log(set_num_log), m_set_block_size(set_block_size), m_sector_log(log_sector_size),
+          m_evicted(0), m_evicted_used(0), m_sector_misses(0), m_sub_misses(0)
+    {
+        assert(log_sector_size >= log_sub_size && log_sector_size - log_sub_size <= 6);
+        m_sub_valids = new UINT64[m_block_num];
+        m_touched = new UINT64[m_block_num];
+        for (UINT32 i = 0; i < m_block_num; i++)
+            m_sub_valids[i] = m_touched[i] = 0;
+    }
+
+    ~SectorCache()
+    {
+        delete[] m_sub_valids;
+        delete[] m_touched;
+    }
+
+    void dumpResults()
+    {
+        CacheModel::dumpResults();
+        UINT64 misses = m_sector_misses + m_sub_misses;
+        printf("\tsector misses: %lu,\tsub-block misses: %lu,\tfetched: %lu bytes\n",
+               m_sector_misses, m_sub_misses, misses << m_blksz_log);
+
+        // 换出的扇区加上仍驻留的扇区
+        UINT64 used = m_evicted_used, sectors = m_evicted;
+        for (UINT32 i = 0; i < m_block_num; i++)
+        {
+            if (!m_valids[i]) continue;
+            used += popcount(m_touched[i]);
+            sectors++;
+        }
+        if (sectors)
+            printf("\tsub-blocks used per sector: %.2f of %u\n", (double)used / sectors, 1u << (m_sector_log - m_blksz_log));
+    }
+
+private:
+    UINT32 m_set_num_log;
+    UINT32 m_set_block_size;
+    UINT32 m_sector_log;        // 扇区大小的对数
+
+    UINT64* m_sub_valids;       // 每个扇区的子块有效位
+    UINT64* m_touched;          // 每个扇区被访问过的子块
+    UINT64 m_evicted;           // 换出的扇区数
+    UINT64 m_evicted_used;      // 换出的扇区用过的子块数之和
+
+    UINT64 m_sector_misses;
+    UINT64 m_sub_misses;
+
+    static UINT32 popcount(UINT64 v)
+    {
+        UINT32 n = 0;
+        for (; v; v &= v - 1)
+            n++;
+        return n;
+    }
+
+    UINT32 get_tag(UINT32 mem_addr) { return mem_addr >> m_sector_log; }
+
+    UINT32 get_set_num(UINT32 mem_addr) { return (mem_addr >> m_sector_log) & ((1u << m_set_num_log) - 1); }
+
+    UINT64 get_sub_bit(UINT32 mem_addr) { return 1ull << ((mem_addr >> m_blksz_log) & ((1u << (m_sector_log - m_blksz_log)) - 1)); }
+
+    // Look up the sector, hit only when the sub-block is valid as well
+    bool lookup(UINT32 mem_addr, UINT32& blk_id)
+    {
+        UINT32 tag = get_tag(mem_addr);
+        UINT32 start = get_set_num(mem_addr) * m_set_block_size;
+        for (UINT32 i = 0; i < m_set_block_size; i++)
+        {
+            if (m_valids[start + i] && m_tags[start + i] == tag)
+            {
+                blk_id = start + i;
+                return (m_sub_valids[blk_id] & get_sub_bit(mem_addr)) != 0;
+            }
+        }
+        blk_id = m_block_num;
+        return false;
+    }
+
+    bool access(UINT32 mem_addr)
+    {
+        UINT32 blk_id;
+        UINT64 sub_bit = get_sub_bit(mem_addr);
+        if (lookup(mem_addr, blk_id))
+        {
+            m_touched[blk_id] |= sub_bit;
+            updateReplaceQ(blk_id);
+            return true;
+        }
+
+        if (blk_id < m_block_num)
+        {
+            m_sub_misses++;
+        }
+        else
+        {
+            m_sector_misses++;
+            blk_id = m_replace_q[get_set_num(mem_addr) * m_set_block_size];
+            if (m_valids[blk_id])
+            {
+                m_evicted++;
+                m_evicted_used += popcount(m_touched[blk_id]);
+            }
+            m_tags[blk_id] = get_tag(mem_addr);
+            m_valids[blk_id] = true;
+            m_sub_valids[blk_id] = m_touched[blk_id] = 0;
+        }
+        m_sub_valids[blk_id] |= sub_bit;
+        m_touched[blk_id] |= sub_bit;
+        updateReplaceQ(blk_id);
+        return false;
+    }
+
+    // Update m_replace_q (LRU inside the set)
+    void updateReplaceQ(UINT32 blk_id)
+    {
+        UINT32 start = blk_id / m_set_block_size * m_set_block_size;
+        for (UINT32 i = 0; i < m_set_block_size; i++)
+        {
+            if (m_replace_q[start + i] == blk_id)
+            {
+                for (UINT32 j = i + 1; j < m_set_block_size; j++)
+                    m_replace_q[start + j - 1] = m_replace_q[start + j];
+                m_replace_q[start + m_set_block_size - 1] = blk_id;
+                break;
+            }
+        }
+    }
+};
+
+/**************************************
+ * Line Size Sweep
+**************************************/
+// 容量和相联度固定, 行大小从2^min_log到2^max_log的一组cache, 一次遍历访存流同时驱动,
+// 不必为每个行大小单独建模和重跑. 组数随行大小变化, 组号取块地址低位.
+class LineSizeSweep
+{
+public:
+    LineSizeSweep(UINT32 capacity_log, UINT32 set_block_size, UINT32 min_blksz_log, UINT32 max_blksz_log)
+    {
+        if (min_blksz_log > max_blksz_log || max_blksz_log > capacity_log)
+        {
+            fprintf(stderr, "line size sweep: line sizes 2^%u..2^%u do not fit a 2^%u-byte cache\n",
+                    min_blksz_log, max_blksz_log, capacity_log);
+            exit(1);
+        }
+        for (UINT32 b = min_blksz_log; b <= max_blksz_log; b++)
+        {
+            UINT32 lines = 1u << (capacity_log - b);
+            UINT32 set_num_log = 0;
+            while ((2u << set_num_log) * set_block_size <= lines)
+                set_num_log++;
+            m_models.push_back(new SetAssoCache_Hashed(set_num_log, set_block_size, b, new BitSliceIndex(set_num_log)));
+        }
+    }
+
+    ~LineSizeSweep()
+    {
+        for (size_t i = 0; i < m_models.size(); i++)
+            delete m_models[i];
+    }
+
+    size_t size() { return m_models.size(); }
+    CacheModel* operator[](size_t i) { return m_models[i]; }
+
+    void readReq(UINT32 mem_addr)
+    {
+        for (size_t i = 0; i < m_models.size(); i++)
+            m_models[i]->readReq(mem_addr);
+    }
+
+    void writeReq(UINT32 mem_addr)
+    {
+        for (size_t i = 0; i < m_models.size(); i++)
+            m_models[i]->writeReq(mem_addr);
+    }
+
+    // Miss rate and memory traffic of every line size
+    void dumpResults()
+    {
+        printf("\t%-12s%-12s%-14s%-16s\n", "line size", "miss rate", "misses", "fetched bytes");
+        for (size_t i = 0; i < m_models.size(); i++)
+        {
+            CacheModel* m = m_models[i];
+            UINT64 reqs = m->getRdReq() + m->getWrReq();
+            printf("\t%-12u%-12.2f%-14lu%-16lu\n", 1u << m->getBlockSizeLog(),
+                   reqs ? 100.0 * m->getMisses() / reqs : 0, m->getMisses(), m->getMisses() << m->getBlockSizeLog());
+        }
+    }
+
+private:
+    std::vector<CacheModel*> m_models;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Show the live statistics published by the cache Pin tool (-stats_shm).
+ *
+ * Build:   g++ -O2 -o cacheStat cacheStat.cpp -lrt
+ * Usage:   ./cacheStat name [interval_seconds]
+ *
+ * name是Pin工具的-stats_shm参数加上 ".被插桩进程的pid" (如 /cacheModel.1234),
+ * Pin工具启动时会打印这个名字. 只读映射共享内存,
+ * 每隔interval秒打印一次各模型的请求数和缺失率; interval为0时只打印一次.
+ * 进程结束 (页面标记为finished) 后打印最终结果并退出.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "cacheStats.h"
+
+static void printPage(const StatsPage& page, const StatsPage& last)
+{
+    double secs = page.elapsed_ms / 1000.0;
+    double rate = page.elapsed_ms > last.elapsed_ms ?
+                  (page.accesses - last.accesses) * 1000.0 / (page.elapsed_ms - last.elapsed_ms) : 0;
+    printf("pid %lu, %.1f s, %lu accesses (%.2f M/s)%s\n", page.pid, secs, page.accesses, rate / 1e6,
+           page.finished ? ", finished" : "");
+    printf("\t%-40s%-16s%-12s%-16s%-12s\n", "model", "read req", "read miss", "write req", "write miss");
+    for (UINT32 i = 0; i < page.model_num && i < CACHE_STATS_MAX_MODELS; i++)
+    {
+        const ModelStats& m = page.models[i];
+        printf("\t%-40.40s%-16lu%-12.2f%-16lu%-12.2f\n", m.name,
+               m.rd_reqs, m.rd_reqs ? 100.0 * (m.rd_reqs - m.rd_hits) / m.rd_reqs : 0,
+               m.wr_reqs, m.wr_reqs ? 100.0 * (m.wr_reqs - m.wr_hits) / m.wr_reqs : 0);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: cacheStat name [interval_seconds]\n");
+        return 1;
+    }
+    UINT32 interval = argc > 2 ? atoi(argv[2]) : 2;
+
+    int fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot open shared memory %s\n", argv[1]);
+        return 1;
+    }
+    void* p = mmap(NULL, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        fprintf(stderr, "cannot map shared memory %s\n", argv[1]);
+        return 1;
+    }
+    const StatsPage* page = (const StatsPage*)p;
+    if (page->magic != CACHE_STATS_MAGIC || page->version != CACHE_STATS_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %u stats page\n", argv[1], CACHE_STATS_VERSION);
+        return 1;
+    }
+
+    StatsPage* snap = new StatsPage;
+    StatsPage* last = new StatsPage;
+    memset(last, 0, sizeof(StatsPage));
+    do
+    {
+        if (!readStatsPage(page, *snap))
+        {
+            fprintf(stderr, "the stats page stays busy\n");
+            continue;
+        }
+        printPage(*snap, *last);
+        if (snap->finished) break;
+        std::swap(snap, last);
+    } while (interval && sleep(interval) == 0);
+
+    delete snap;
+    delete last;
+    munmap(p, sizeof(StatsPage));
+    return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+
+/*
+ * Live statistics page shared between the Pin tool (writer) and cacheStat (reader).
+ *
+ * 页面放在POSIX共享内存中, 只有一个写者 (Pin工具的内部线程), 用顺序锁保护:
+ * 写者在修改前后各把seq加1, seq为奇数表示正在修改; 读者复制整个页面,
+ * 前后两次读到的seq相等且为偶数时副本才是一致的, 否则重试. 读者从不写页面,
+ * 因此不会拖慢被插桩的进程.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef unsigned int        UINT32;
+typedef unsigned long int   UINT64;
+
+#define CACHE_STATS_MAGIC       0x41545343      // "CSTA"
+#define CACHE_STATS_VERSION     1
+#define CACHE_STATS_MAX_MODELS  32
+
+struct ModelStats
+{
+    char name[48];
+    UINT64 rd_reqs;
+    UINT64 rd_hits;
+    UINT64 wr_reqs;
+    UINT64 wr_hits;
+};
+
+struct StatsPage
+{
+    UINT32 magic;
+    UINT32 version;
+    UINT64 seq;                 // 顺序锁计数, 奇数表示写者正在修改
+    UINT64 pid;                 // 被插桩进程的pid
+    UINT64 updates;             // 已发布的次数
+    UINT64 elapsed_ms;          // 从工具启动到本次发布的时间
+    UINT64 accesses;            // 已处理的访存次数 (进度)
+    UINT32 finished;            // 进程已经结束, 数值为最终结果
+    UINT32 model_num;
+    ModelStats models[CACHE_STATS_MAX_MODELS];
+};
+
+/**************************************
+ * Stats Page Writer
+**************************************/
+class StatsWriter
+{
+public:
+    StatsWriter() : m_page(NULL) {}
+    ~StatsWriter() { close(); }
+
+    // Create (or replace) the shared-memory segment name, e.g. "/cacheModel.1234" (the Pin tool appends its pid)
+    bool open(const char* name, UINT64 pid)
+    {
+        int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, sizeof(StatsPage)) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(NULL, sizeof(StatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+
+        m_name = name;
+        m_page = (StatsPage*)p;
+        memset(m_page, 0, sizeof(StatsPage));
+        m_page->version = CACHE_STATS_VERSION;
+        m_page->pid = pid;
+        __atomic_store_n(&m_page->magic, CACHE_STATS_MAGIC, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Enter the write section; the page may be modified until endUpdate()
+    StatsPage* beginUpdate()
+    {
+        __atomic_store_n(&m_page->seq, m_page->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        return m_page;
+    }
+
+    void endUpdate()
+    {
+        m_page->updates++;
+        __atomic_store_n(&m_page->seq, m_page->seq + 1, __ATOMIC_RELEASE);
+    }
+
+    // Unmap and remove the segment; readers that still map it keep the last contents
+    void close()
+    {
+        if (!m_page) return;
+        munmap(m_page, sizeof(StatsPage));
+        shm_unlink(m_name.c_str());
+        m_page = NULL;
+    }
+
+private:
+    StatsPage* m_page;
+    std::string m_name;
+};
+
+// Take a consistent snapshot of a page written concurrently, false if the writer
+// kept it busy for all the retries
+inline bool readStatsPage(const StatsPage* page, StatsPage& snap, UINT32 retries = 1000)
+{
+    for (UINT32 i = 0; i < retries; i++)
+    {
+        UINT64 seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+        memcpy(&snap, page, sizeof(StatsPage));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == seq) return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef MEM_TRACE_H
+#define MEM_TRACE_H
+
+/*
+ * Compressed memory-access trace: writer and zero-copy reader.
+ *
+ * File layout:
+ *      [FileHeader] [chunk 0] [chunk 1] ... [pad] [ChunkIndex x chunk_num] [FileFooter]
+ *
+ * 索引前补零到alignof(ChunkIndex), 读端可以直接在映射上访问索引.
+ * 每个chunk独立编码 (线程状态和PC字典在chunk开头清空), 因此可以借助索引随机定位.
+ * 一条记录的编码:
+ *      flag    1 byte: bit0 写访问, bit1 线程切换, bit2 PC命中字典, bit3-6 访问大小编码
+ *      [tid]   varint, 仅当bit1置位
+ *      pc      varint字典下标 (bit2置位), 否则为相对上一个字面PC的zigzag varint差值
+ *      [size]  varint, 仅当大小编码为SIZE_ESCAPE
+ *      addr    相对本线程上一次访问地址的zigzag varint差值
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef unsigned char       UINT8;
+typedef unsigned int        UINT32;
+typedef unsigned long int   UINT64;
+
+#define MEM_TRACE_MAGIC         0x4352544d      // "MTRC"
+#define MEM_TRACE_VERSION       1
+#define MEM_TRACE_CHUNK_RECS    (1u << 16)      // 每个chunk的记录数
+#define MEM_TRACE_MAX_TID       (1u << 16)      // 读端认为合理的最大线程号, 更大的视为损坏
+
+// One decoded memory access
+struct MemAccess
+{
+    UINT64 pc;
+    UINT64 addr;
+    UINT32 tid;
+    UINT32 size;
+    bool is_write;
+};
+
+namespace mtrace
+{
+    struct FileHeader
+    {
+        UINT32 magic;
+        UINT32 version;
+    };
+
+    struct ChunkIndex
+    {
+        UINT64 offset;          // chunk在文件中的偏移
+        UINT64 bytes;           // chunk编码后的长度
+        UINT64 first_rec;       // chunk第一条记录的全局序号
+        UINT64 rec_num;         // chunk中的记录数
+    };
+
+    struct FileFooter
+    {
+        UINT64 index_offset;
+        UINT64 chunk_num;
+        UINT64 rec_num;
+        UINT32 magic;
+        UINT32 version;
+    };
+
+    enum
+    {
+        FLAG_WRITE      = 1 << 0,
+        FLAG_TID        = 1 << 1,
+        FLAG_PC_DICT    = 1 << 2,
+        SIZE_SHIFT      = 3,
+        SIZE_ESCAPE     = 15
+    };
+
+    inline UINT64 zigzag(UINT64 delta) { return (delta << 1) ^ (UINT64)((long)delta >> 63); }
+    inline UINT64 unzigzag(UINT64 val) { return (val >> 1) ^ (UINT64)(-(long)(val & 1)); }
+
+    inline void putVarint(std::vector<UINT8>& buf, UINT64 val)
+    {
+        while (val >= 0x80)
+        {
+            buf.push_back((UINT8)(val | 0x80));
+            val >>= 7;
+        }
+        buf.push_back((UINT8)val);
+    }
+
+    // Decode a varint from [p, end), return false if it runs past end or over 64 bits
+    inline bool getVarint(const UINT8*& p, const UINT8* end, UINT64& val)
+    {
+        val = 0;
+        for (UINT32 shift = 0; shift < 64 && p < end; shift += 7)
+        {
+            UINT8 b = *p++;
+            val |= (UINT64)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // 1,2,4,...,64 编码为 0..6, 其它大小需要转义
+    inline UINT32 sizeCode(UINT32 size)
+    {
+        if (size == 0 || size > 64 || (size & (size - 1))) return SIZE_ESCAPE;
+        return __builtin_ctz(size);
+    }
+}
+
+/**************************************
+ * Trace Writer
+**************************************/
+// 非线程安全, 多线程调用者需自行加锁
+// 写入失败 (如磁盘已满) 后不再写文件, close()返回false
+class MemTraceWriter
+{
+public:
+    MemTraceWriter() : m_fp(NULL), m_ok(false), m_rec_num(0) {}
+    ~MemTraceWriter() { close(); }
+
+    bool open(const char* path)
+    {
+        m_fp = fopen(path, "wb");
+        if (!m_fp) return false;
+
+        mtrace::FileHeader hdr = { MEM_TRACE_MAGIC, MEM_TRACE_VERSION };
+        m_ok = true;
+        m_offset = 0;
+        m_rec_num = 0;
+        m_index.clear();
+        put(&hdr, sizeof(hdr));
+        resetChunk();
+        return m_ok;
+    }
+
+    void append(const MemAccess& rec)
+    {
+        UINT8 flag = rec.is_write ? mtrace::FLAG_WRITE : 0;
+        if (rec.tid != m_cur_tid) flag |= mtrace::FLAG_TID;
+
+        std::unordered_map<UINT64, UINT32>::iterator it = m_pc_dict.find(rec.pc);
+        if (it != m_pc_dict.end()) flag |= mtrace::FLAG_PC_DICT;
+
+        UINT32 code = mtrace::sizeCode(rec.size);
+        flag |= code << mtrace::SIZE_SHIFT;
+        m_buf.push_back(flag);
+
+        if (flag & mtrace::FLAG_TID)
+        {
+            mtrace::putVarint(m_buf, rec.tid);
+            m_cur_tid = rec.tid;
+        }
+
+        if (flag & mtrace::FLAG_PC_DICT)
+            mtrace::putVarint(m_buf, it->second);
+        else
+        {
+            mtrace::putVarint(m_buf, mtrace::zigzag(rec.pc - m_last_pc));
+            m_last_pc = rec.pc;
+            UINT32 idx = m_pc_dict.size();
+            m_pc_dict[rec.pc] = idx;
+        }
+
+        if (code == mtrace::SIZE_ESCAPE)
+            mtrace::putVarint(m_buf, rec.size);
+
+        if (rec.tid >= m_last_addr.size()) m_last_addr.resize(rec.tid + 1, 0);
+        mtrace::putVarint(m_buf, mtrace::zigzag(rec.addr - m_last_addr[rec.tid]));
+        m_last_addr[rec.tid] = rec.addr;
+
+        if (++m_chunk_recs == MEM_TRACE_CHUNK_RECS)
+            flushChunk();
+    }
+
+    // Flush the last chunk, then write the index and the footer; return false if any write failed
+    bool close()
+    {
+        if (!m_fp) return m_ok;
+        flushChunk();
+
+        static const UINT8 zeros[alignof(mtrace::ChunkIndex)] = { 0 };
+        UINT64 pad = (alignof(mtrace::ChunkIndex) - m_offset % alignof(mtrace::ChunkIndex)) % alignof(mtrace::ChunkIndex);
+        put(zeros, pad);
+
+        mtrace::FileFooter footer;
+        footer.index_offset = m_offset;
+        footer.chunk_num = m_index.size();
+        footer.rec_num = m_rec_num;
+        footer.magic = MEM_TRACE_MAGIC;
+        footer.version = MEM_TRACE_VERSION;
+        if (!m_index.empty())
+            put(&m_index[0], sizeof(mtrace::ChunkIndex) * m_index.size());
+        put(&footer, sizeof(footer));
+
+        if (fclose(m_fp) != 0) m_ok = false;
+        m_fp = NULL;
+        return m_ok;
+    }
+
+    UINT64 getRecNum() { return m_rec_num + m_chunk_recs; }
+
+private:
+    FILE* m_fp;
+    bool m_ok;                              // 目前为止的写入都成功
+    UINT64 m_offset;
+    UINT64 m_rec_num;                       // 已写出的chunk中的记录数
+    std::vector<mtrace::ChunkIndex> m_index;
+
+    // 当前chunk的编码状态
+    std::vector<UINT8> m_buf;
+    UINT64 m_chunk_recs;
+    UINT32 m_cur_tid;
+    UINT64 m_last_pc;
+    std::vector<UINT64> m_last_addr;        // 每个线程上一次访问的地址
+    std::unordered_map<UINT64, UINT32> m_pc_dict;
+
+    void resetChunk()
+    {
+        m_buf.clear();
+        m_chunk_recs = 0;
+        m_cur_tid = 0;
+        m_last_pc = 0;
+        m_last_addr.clear();
+        m_pc_dict.clear();
+    }
+
+    void put(const void* data, size_t bytes)
+    {
+        if (!m_ok || bytes == 0) return;
+        if (fwrite(data, 1, bytes, m_fp) != bytes)
+        {
+            m_ok = false;
+            return;
+        }
+        m_offset += bytes;
+    }
+
+    void flushChunk()
+    {
+        if (m_chunk_recs == 0) return;
+
+        mtrace::ChunkIndex idx = { m_offset, m_buf.size(), m_rec_num, m_chunk_recs };
+        put(&m_buf[0], m_buf.size());
+        m_index.push_back(idx);
+        m_rec_num += m_chunk_recs;
+        resetChunk();
+    }
+};
+
+/**************************************
+ * Trace Reader
+**************************************/
+// 整个文件mmap到内存, 索引和chunk数据都直接在映射上解码, 不做拷贝.
+// open时检查索引中每个chunk都在文件的数据区内; 解码时不越过chunk的末尾, 遇到越界的
+// varint、不存在的字典下标或不合理的线程号时停止, next()返回false且isCorrupt()为真.
+class MemTraceReader
+{
+public:
+    MemTraceReader() : m_base(NULL), m_len(0), m_index(NULL), m_chunk_num(0), m_rec_num(0), m_corrupt(false) {}
+    ~MemTraceReader() { close(); }
+
+    bool open(const char* path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(mtrace::FileHeader) + sizeof(mtrace::FileFooter))
+        {
+            ::close(fd);
+            return false;
+        }
+        m_len = st.st_size;
+        void* p = mmap(NULL, m_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        m_base = (const UINT8*)p;
+        madvise(p, m_len, MADV_SEQUENTIAL);
+
+        const mtrace::FileHeader* hdr = (const mtrace::FileHeader*)m_base;
+        mtrace::FileFooter footer;
+        memcpy(&footer, m_base + m_len - sizeof(footer), sizeof(footer));
+        UINT64 index_end = m_len - sizeof(footer);
+        if (hdr->magic != MEM_TRACE_MAGIC || footer.magic != MEM_TRACE_MAGIC || hdr->version != MEM_TRACE_VERSION
+            || footer.index_offset % alignof(mtrace::ChunkIndex) != 0 || footer.index_offset > index_end
+            || footer.chunk_num > (index_end - footer.index_offset) / sizeof(mtrace::ChunkIndex))
+        {
+            close();
+            return false;
+        }
+
+        m_index = (const mtrace::ChunkIndex*)(m_base + footer.index_offset);
+        m_chunk_num = footer.chunk_num;
+        m_rec_num = footer.rec_num;
+
+        // 每个chunk都要落在文件头和索引之间, 记录序号连续 (seek的二分查找依赖这一点)
+        UINT64 first_rec = 0;
+        for (UINT64 c = 0; c < m_chunk_num; c++)
+        {
+            const mtrace::ChunkIndex& idx = m_index[c];
+            if (idx.offset < sizeof(mtrace::FileHeader) || idx.offset > footer.index_offset
+                || idx.bytes > footer.index_offset - idx.offset || idx.first_rec != first_rec || idx.rec_num == 0)
+            {
+                close();
+                return false;
+            }
+            first_rec += idx.rec_num;
+        }
+        if (first_rec != m_rec_num)
+        {
+            close();
+            return false;
+        }
+        m_corrupt = false;
+        return seek(0);
+    }
+
+    void close()
+    {
+        if (m_base) munmap((void*)m_base, m_len);
+        m_base = NULL;
+    }
+
+    UINT64 getRecNum() { return m_rec_num; }
+
+    // True once next() stopped at a record that could not be decoded
+    bool isCorrupt() { return m_corrupt; }
+
+    // Position the reader so that next() returns record number rec_no
+    bool seek(UINT64 rec_no)
+    {
+        if (rec_no >= m_rec_num)
+        {
+            m_chunk = m_chunk_num;
+            m_left = 0;
+            return rec_no == m_rec_num;
+        }
+
+        // Binary search the chunk containing rec_no
+        UINT64 lo = 0, hi = m_chunk_num - 1;
+        while (lo < hi)
+        {
+            UINT64 mid = (lo + hi + 1) / 2;
+            if (m_index[mid].first_rec <= rec_no) lo = mid;
+            else hi = mid - 1;
+        }
+        enterChunk(lo);
+
+        MemAccess rec;
+        for (UINT64 skip = rec_no - m_index[lo].first_rec; skip; skip--)
+            if (!next(rec)) return false;
+        return true;
+    }
+
+    // Decode the next record, return false at the end of the trace
+    bool next(MemAccess& rec)
+    {
+        if (m_corrupt) return false;
+        if (m_left == 0)
+        {
+            if (m_chunk + 1 >= m_chunk_num) return false;
+            enterChunk(m_chunk + 1);
+        }
+        m_left--;
+
+        UINT64 val;
+        if (m_p >= m_chunk_end) return corrupt();
+        UINT8 flag = *m_p++;
+        if (flag & mtrace::FLAG_TID)
+        {
+            if (!mtrace::getVarint(m_p, m_chunk_end, val) || val >= MEM_TRACE_MAX_TID) return corrupt();
+            m_cur_tid = val;
+        }
+
+        if (!mtrace::getVarint(m_p, m_chunk_end, val)) return corrupt();
+        if (flag & mtrace::FLAG_PC_DICT)
+        {
+            if (val >= m_pc_dict.size()) return corrupt();
+            rec.pc = m_pc_dict[val];
+        }
+        else
+        {
+            m_last_pc += mtrace::unzigzag(val);
+            rec.pc = m_last_pc;
+            m_pc_dict.push_back(rec.pc);
+        }
+
+        UINT32 code = (flag >> mtrace::SIZE_SHIFT) & 0xf;
+        rec.size = 1u << (code & 7);
+        if (code == mtrace::SIZE_ESCAPE)
+        {
+            if (!mtrace::getVarint(m_p, m_chunk_end, val)) return corrupt();
+            rec.size = val;
+        }
+        else if (code > 6) return corrupt();
+
+        if (!mtrace::getVarint(m_p, m_chunk_end, val)) return corrupt();
+        if (m_cur_tid >= m_last_addr.size()) m_last_addr.resize(m_cur_tid + 1, 0);
+        m_last_addr[m_cur_tid] += mtrace::unzigzag(val);
+
+        rec.addr = m_last_addr[m_cur_tid];
+        rec.tid = m_cur_tid;
+        rec.is_write = flag & mtrace::FLAG_WRITE;
+        return true;
+    }
+
+private:
+    const UINT8* m_base;
+    size_t m_len;
+    const mtrace::ChunkIndex* m_index;
+    UINT64 m_chunk_num;
+    UINT64 m_rec_num;
+    bool m_corrupt;
+
+    // 当前chunk的解码状态
+    UINT64 m_chunk;
+    UINT64 m_left;                          // 当前chunk中剩余的记录数
+    const UINT8* m_p;
+    const UINT8* m_chunk_end;
+    UINT32 m_cur_tid;
+    UINT64 m_last_pc;
+    std::vector<UINT64> m_last_addr;
+    std::vector<UINT64> m_pc_dict;
+
+    void enterChunk(UINT64 chunk)
+    {
+        m_chunk = chunk;
+        m_left = m_index[chunk].rec_num;
+        m_p = m_base + m_index[chunk].offset;
+        m_chunk_end = m_p + m_index[chunk].bytes;
+        m_cur_tid = 0;
+        m_last_pc = 0;
+        m_last_addr.clear();
+        m_pc_dict.clear();
+    }
+
+    bool corrupt()
+    {
+        m_corrupt = true;
+        m_left = 0;
+        return false;
+    }
+};
+
+#endif